@@ -0,0 +1,32 @@
+#include "attacks.h"
+#include "pawns.h"
+
+void attack_map_t::update(const board_t &board) {
+    if (is_current(board)) return;
+    key = board.record.back().hash;
+
+    for (Team team : {WHITE, BLACK}) {
+        U64 left = team == WHITE ? pawns::left_attacks<WHITE>(board.bb_pieces[team][PAWN])
+                                 : pawns::left_attacks<BLACK>(board.bb_pieces[team][PAWN]);
+        U64 right = team == WHITE ? pawns::right_attacks<WHITE>(board.bb_pieces[team][PAWN])
+                                  : pawns::right_attacks<BLACK>(board.bb_pieces[team][PAWN]);
+        pieces[team][PAWN] = left | right;
+        sides[team] = left | right;
+        double_attacks[team] = left & right;
+
+        for (int type = KNIGHT; type <= KING; type++) {
+            pieces[team][type] = 0;
+
+            U64 bb = board.bb_pieces[team][type];
+            while (bb) {
+                uint8_t sq = pop_bit(bb);
+                U64 attacks = find_moves(Piece(type), team, sq, board.bb_all);
+
+                squares[sq] = attacks;
+                pieces[team][type] |= attacks;
+                double_attacks[team] |= sides[team] & attacks;
+                sides[team] |= attacks;
+            }
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef TOPPLE_ATTACKS_H
+#define TOPPLE_ATTACKS_H
+
+#include "types.h"
+#include "board.h"
+
+/**
+ * Squares attacked by every piece in a position. The map is built once for a position, and then shared by the
+ * evaluation, move generation, move ordering and static exchange evaluation instead of repeating the same lookups.
+ */
+struct attack_map_t {
+    /**
+     * Build the map for the current position of the board, unless it already describes that position
+     */
+    void update(const board_t &board);
+
+    /**
+     * @return whether the map describes the current position of the board
+     */
+    bool is_current(const board_t &board) const {
+        return key == board.record.back().hash;
+    }
+
+    /**
+     * @return whether the side to move is in check
+     */
+    bool is_incheck(const board_t &board) const {
+        Team side = board.record.back().next_move;
+        return (sides[!side] & board.bb_pieces[side][KING]) != 0;
+    }
+
+    U64 key = ~U64(0); // Hash of the position described by the map
+
+    U64 squares[64]; // [SQUARE] Attacks of the piece on each square, for all pieces except pawns
+    U64 pieces[2][6]; // [TEAM][PIECE]
+    U64 sides[2]; // [TEAM]
+    U64 double_attacks[2]; // [TEAM] Squares attacked at least twice, counting each pawn capture direction separately
+};
+
+#endif //TOPPLE_ATTACKS_H
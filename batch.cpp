@@ -0,0 +1,540 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "batch.h"
+#include "board.h"
+#include "search.h"
+#include "movegen.h"
+
+#include "syzygy/tbprobe.h"
+
+namespace batch {
+    namespace {
+        struct options_t {
+            int depth = MAX_PLY;
+            U64 nodes = UINT64_MAX;
+            int movetime = INT_MAX;
+            size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+            size_t hash_mb = 128; // Total over all jobs
+            bool shared_hash = false;
+            bool csv = false;
+            std::string syzygy_path;
+
+            [[nodiscard]] bool has_limit() const {
+                return depth != MAX_PLY || nodes != UINT64_MAX || movetime != INT_MAX;
+            }
+
+            [[nodiscard]] search_limits_t limits() const {
+                return search_limits_t(movetime, depth, nodes, std::vector<move_t>());
+            }
+        };
+
+        struct position_t {
+            std::string fen;
+            std::map<std::string, std::string> operations; // EPD opcode to operand
+        };
+
+        // Serialises the results written by the jobs
+        std::mutex output_mtx;
+
+        bool is_number(const std::string &str) {
+            return !str.empty() && std::all_of(str.begin(), str.end(), [](char ch) { return ch >= '0' && ch <= '9'; });
+        }
+
+        /**
+         * Parse a line of an EPD or FEN file. EPD lines have four FEN fields followed by semicolon-terminated
+         * operations; FEN lines may also carry the halfmove clock and fullmove number.
+         */
+        bool parse_position(const std::string &line, position_t &position) {
+            std::istringstream iss(line);
+            std::string field;
+
+            position.fen.clear();
+            for (int i = 0; i < 4; i++) {
+                if (!(iss >> field)) return false;
+                position.fen += field + " ";
+            }
+
+            // Optional move counters
+            for (int i = 0; i < 2; i++) {
+                std::streampos pos = iss.tellg();
+                if (iss >> field && is_number(field)) {
+                    position.fen += field + " ";
+                } else {
+                    iss.clear();
+                    iss.seekg(pos);
+                    break;
+                }
+            }
+
+            position.fen.pop_back();
+
+            // Operations, which may contain quoted semicolons
+            std::string rest((std::istreambuf_iterator<char>(iss)), std::istreambuf_iterator<char>());
+            std::string operation;
+            bool quoted = false;
+            for (char ch : rest) {
+                if (ch == '"') quoted = !quoted;
+                if (ch == ';' && !quoted) {
+                    std::istringstream op(operation);
+                    std::string opcode, operand;
+                    if (op >> opcode) {
+                        std::getline(op >> std::ws, operand);
+                        if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"') {
+                            operand = operand.substr(1, operand.size() - 2);
+                        }
+                        position.operations[opcode] = operand;
+                    }
+                    operation.clear();
+                } else {
+                    operation += ch;
+                }
+            }
+
+            return true;
+        }
+
+        bool read_positions(const std::string &file, std::vector<position_t> &positions) {
+            std::ifstream stream(file);
+            if (!stream) return false;
+
+            std::string line;
+            while (std::getline(stream, line)) {
+                if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#') continue;
+
+                position_t position;
+                if (parse_position(line, position)) {
+                    positions.push_back(position);
+                } else {
+                    std::cerr << "warn: skipping malformed line: " << line << std::endl;
+                }
+            }
+
+            return true;
+        }
+
+        void print_usage(const std::string &mode) {
+            std::cerr << "usage: Topple " << mode << " <file> [--depth N] [--nodes N] [--movetime ms] [--jobs N]"
+                         " [--hash MB] [--shared-hash]" << (mode == "analyse" ? " [--format jsonl|csv]" : "")
+                      << " [--syzygy path]" << std::endl;
+        }
+
+        bool parse_options(const std::string &mode, int argc, char *argv[], options_t &options, std::string &file) {
+            for (int i = 0; i < argc; i++) {
+                std::string arg = argv[i];
+                bool has_value = i + 1 < argc;
+
+                try {
+                    if (arg == "--depth" && has_value) {
+                        options.depth = std::max(1, std::min(MAX_PLY, std::stoi(argv[++i])));
+                    } else if (arg == "--nodes" && has_value) {
+                        options.nodes = std::stoull(argv[++i]);
+                    } else if (arg == "--movetime" && has_value) {
+                        options.movetime = std::stoi(argv[++i]);
+                    } else if (arg == "--jobs" && has_value) {
+                        options.jobs = std::max(1, std::stoi(argv[++i]));
+                    } else if (arg == "--hash" && has_value) {
+                        options.hash_mb = std::max(1, std::stoi(argv[++i]));
+                    } else if (arg == "--shared-hash") {
+                        options.shared_hash = true;
+                    } else if (arg == "--format" && has_value && mode == "analyse") {
+                        std::string format = argv[++i];
+                        if (format != "jsonl" && format != "csv") {
+                            std::cerr << "error: unknown format " << format << ", expected jsonl or csv" << std::endl;
+                            return false;
+                        }
+                        options.csv = format == "csv";
+                    } else if (arg == "--syzygy" && has_value) {
+                        options.syzygy_path = argv[++i];
+                    } else if (arg.rfind("--", 0) == 0) {
+                        std::cerr << "error: unrecognised or incomplete option " << arg << std::endl;
+                        return false;
+                    } else if (file.empty()) {
+                        file = arg;
+                    } else {
+                        std::cerr << "error: unexpected argument " << arg << std::endl;
+                        return false;
+                    }
+                } catch (std::exception &) {
+                    std::cerr << "error: invalid value " << argv[i] << " for " << arg << std::endl;
+                    print_usage(mode);
+                    return false;
+                }
+            }
+
+            if (file.empty()) {
+                print_usage(mode);
+                return false;
+            }
+
+            return true;
+        }
+
+        std::string json_escape(const std::string &str) {
+            std::string escaped;
+            for (char ch : str) {
+                if (ch == '"' || ch == '\\') {
+                    escaped += '\\';
+                    escaped += ch;
+                } else if (static_cast<unsigned char>(ch) < 0x20) {
+                    escaped += ' ';
+                } else {
+                    escaped += ch;
+                }
+            }
+            return escaped;
+        }
+
+        std::string csv_escape(const std::string &str) {
+            if (str.find_first_of(",\"") == std::string::npos) return str;
+
+            std::string escaped = "\"";
+            for (char ch : str) {
+                if (ch == '"') escaped += '"';
+                escaped += ch;
+            }
+            return escaped + "\"";
+        }
+
+        int to_mate(int score) {
+            if (score > MINCHECKMATE) return (TO_MATE_PLY(score) + 1) / 2;
+            if (score < -MINCHECKMATE) return -((TO_MATE_PLY(-score) + 1) / 2);
+            return 0;
+        }
+
+        std::string format_result(const options_t &options, size_t index, const position_t &position,
+                                  const search_result_t &result, U64 time) {
+            std::ostringstream pv;
+            for (size_t i = 0; i < result.pv.size() && result.pv[i] != EMPTY_MOVE; i++) {
+                if (i) pv << " ";
+                pv << result.pv[i];
+            }
+
+            std::ostringstream best_move;
+            best_move << result.best_move;
+
+            auto id = position.operations.find("id");
+            std::string id_str = id == position.operations.end() ? "" : id->second;
+            int mate = to_mate(result.score);
+
+            std::ostringstream line;
+            if (options.csv) {
+                line << index << "," << csv_escape(id_str) << "," << csv_escape(position.fen) << ","
+                     << best_move.str() << "," << (mate ? 0 : result.score) << "," << mate << ","
+                     << result.depth << "," << result.nodes << "," << time << "," << pv.str();
+            } else {
+                line << "{\"index\":" << index
+                     << ",\"id\":\"" << json_escape(id_str) << "\""
+                     << ",\"fen\":\"" << json_escape(position.fen) << "\""
+                     << ",\"bestmove\":\"" << best_move.str() << "\""
+                     << ",\"score\":" << (mate ? 0 : result.score)
+                     << ",\"mate\":" << mate
+                     << ",\"depth\":" << result.depth
+                     << ",\"nodes\":" << result.nodes
+                     << ",\"time\":" << time
+                     << ",\"pv\":\"" << pv.str() << "\"}";
+            }
+            return line.str();
+        }
+
+        std::vector<move_t> legal_moves(const board_t &board) {
+            movegen_t movegen(board);
+            move_t buf[192];
+            int count = movegen.gen_normal(buf);
+
+            std::vector<move_t> moves;
+            for (int i = 0; i < count; i++) {
+                if (board.is_legal(buf[i])) moves.push_back(buf[i]);
+            }
+            return moves;
+        }
+
+        /**
+         * Standard algebraic notation of a legal move, without check or mate markers
+         */
+        std::string to_san(const board_t &board, const std::vector<move_t> &legal, move_t move) {
+            if (board.is_castle(move)) return move.info.to < move.info.from ? "O-O-O" : "O-O";
+
+            const Piece piece = board.moving_piece(move);
+            std::string san;
+            if (piece == PAWN) {
+                if (board.is_capture(move)) san += from_sq(move.info.from)[0];
+            } else {
+                san += "PNBRQK"[piece];
+
+                // Disambiguate between pieces of the same type moving to the same square
+                bool ambiguous = false, same_file = false, same_rank = false;
+                for (move_t other : legal) {
+                    if (board.moving_piece(other) == piece && other.info.to == move.info.to
+                        && other.info.from != move.info.from) {
+                        ambiguous = true;
+                        same_file |= file_index(other.info.from) == file_index(move.info.from);
+                        same_rank |= rank_index(other.info.from) == rank_index(move.info.from);
+                    }
+                }
+
+                std::string from = from_sq(move.info.from);
+                if (ambiguous && (!same_file || same_rank)) san += from[0];
+                if (ambiguous && same_file) san += from[1];
+            }
+
+            if (board.is_capture(move)) san += 'x';
+            san += from_sq(move.info.to);
+            if (is_promotion(move)) san += "PNBRQK"[move.info.promotion_type];
+
+            return san;
+        }
+
+        /**
+         * Strip annotations from a SAN move, so that "Nf3+", "Nf3!" and "e8=Q" compare equal to the output of to_san
+         */
+        std::string normalise_san(const std::string &san) {
+            std::string normalised;
+            for (char ch : san) {
+                if (ch == '0') ch = 'O';
+                if (ch != '+' && ch != '#' && ch != '!' && ch != '?' && ch != '=') normalised += ch;
+            }
+            return normalised;
+        }
+
+        /**
+         * Resolve the moves of an EPD operand, which are given in SAN or, occasionally, in coordinate notation
+         */
+        std::vector<move_t> parse_moves(const board_t &board, const std::string &operand) {
+            std::vector<move_t> legal = legal_moves(board);
+            std::vector<move_t> moves;
+
+            std::istringstream iss(operand);
+            std::string token;
+            while (iss >> token) {
+                std::string san = normalise_san(token);
+                auto it = std::find_if(legal.begin(), legal.end(), [&](move_t move) {
+                    std::ostringstream uci;
+                    uci << move;
+                    return to_san(board, legal, move) == san || uci.str() == token;
+                });
+
+                if (it != legal.end()) {
+                    moves.push_back(*it);
+                } else {
+                    std::lock_guard<std::mutex> lock(output_mtx);
+                    std::cerr << "warn: unrecognised move " << token << std::endl;
+                }
+            }
+            return moves;
+        }
+
+        bool load_positions(const std::string &file, std::vector<position_t> &positions) {
+            if (!read_positions(file, positions)) {
+                std::cerr << "error: could not open " << file << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        U64 elapsed_ms(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+        }
+
+        /**
+         * Search the positions with a pool of single-threaded searches, one per job, each with its own evaluator.
+         * Positions are handed out in file order, and {@code job} is called on the job's thread for every position
+         * which could be set up. Searches which are not silent must be given an info callback by the job.
+         */
+        void run_jobs(options_t &options, const std::vector<position_t> &positions, bool silent,
+                      const std::function<void(search_t &, board_t &, size_t)> &job) {
+            if (!options.syzygy_path.empty()) init_tablebases(options.syzygy_path.c_str());
+
+            options.jobs = std::max<size_t>(1, std::min(options.jobs, positions.size()));
+
+            // Either every job shares one table, or the budget is split between the jobs
+            processed_params_t params = processed_params_t(eval_params_t());
+            std::vector<std::unique_ptr<tt::hash_t>> tables;
+            if (options.shared_hash) {
+                tables.push_back(std::make_unique<tt::hash_t>(options.hash_mb * MB));
+            } else {
+                for (size_t i = 0; i < options.jobs; i++) {
+                    tables.push_back(std::make_unique<tt::hash_t>(
+                            std::max<size_t>(1, options.hash_mb / options.jobs) * MB));
+                }
+            }
+
+            std::atomic<size_t> next{0};
+
+            auto worker = [&](size_t job_id) {
+                tt::hash_t *tt = tables[options.shared_hash ? 0 : job_id].get();
+                search_t search(tt, params, 1, silent);
+
+                size_t index;
+                while ((index = next++) < positions.size()) {
+                    std::unique_ptr<board_t> board;
+                    try {
+                        board = std::make_unique<board_t>(positions[index].fen);
+                    } catch (std::exception &e) {
+                        std::lock_guard<std::mutex> lock(output_mtx);
+                        std::cerr << "warn: position " << index << ": " << e.what() << std::endl;
+                        continue;
+                    }
+
+                    job(search, *board, index);
+
+                    // A shared table is aged by nobody, as the generation counter is not thread-safe
+                    if (!options.shared_hash) tt->age();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < options.jobs; i++) {
+                threads.emplace_back(worker, i);
+            }
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+        }
+    }
+
+    int analyse(int argc, char *argv[]) {
+        options_t options;
+        std::string file;
+        std::vector<position_t> positions;
+        if (!parse_options("analyse", argc, argv, options, file) || !load_positions(file, positions)) return 1;
+
+        // Without any limit the searches would never finish
+        if (!options.has_limit()) options.depth = 12;
+
+        if (options.csv) std::cout << "index,id,fen,bestmove,score,mate,depth,nodes,time,pv" << std::endl;
+
+        run_jobs(options, positions, true, [&options, &positions](search_t &search, board_t &board, size_t index) {
+            std::atomic_bool aborted = false;
+
+            auto start = std::chrono::steady_clock::now();
+            search.enable_timer();
+            search_result_t result = search.think(board, options.limits(), aborted);
+            search.reset_timer();
+
+            std::string line = format_result(options, index, positions[index], result, elapsed_ms(start));
+            std::lock_guard<std::mutex> lock(output_mtx);
+            std::cout << line << std::endl;
+        });
+
+        return 0;
+    }
+
+    int suite(int argc, char *argv[]) {
+        options_t options;
+        std::string file;
+        std::vector<position_t> positions;
+        if (!parse_options("suite", argc, argv, options, file) || !load_positions(file, positions)) return 1;
+
+        if (!options.has_limit()) options.movetime = 1000;
+
+        struct solution_t {
+            bool solved = false;
+            U64 time = 0;
+            U64 nodes = 0;
+        };
+        std::vector<solution_t> solutions(positions.size());
+        size_t tested = 0;
+
+        run_jobs(options, positions, false, [&](search_t &search, board_t &board, size_t index) {
+            const position_t &position = positions[index];
+            auto bm = position.operations.find("bm");
+            auto am = position.operations.find("am");
+            if (bm == position.operations.end() && am == position.operations.end()) {
+                std::lock_guard<std::mutex> lock(output_mtx);
+                std::cerr << "warn: position " << index << " has no bm or am operation" << std::endl;
+                return;
+            }
+
+            std::vector<move_t> best = bm == position.operations.end() ? std::vector<move_t>()
+                                                                        : parse_moves(board, bm->second);
+            std::vector<move_t> avoid = am == position.operations.end() ? std::vector<move_t>()
+                                                                         : parse_moves(board, am->second);
+            auto correct = [&](move_t move) {
+                if (!best.empty() && std::find(best.begin(), best.end(), move) == best.end()) return false;
+                return std::find(avoid.begin(), avoid.end(), move) == avoid.end();
+            };
+
+            // The solution is found when the best move last changed to a correct move
+            solution_t solution;
+            bool found = false;
+            search.set_info_callback([&](const search_info_t &info) {
+                if (info.bound == tt::UPPER || info.pv.empty()) return;
+                if (!correct(info.pv[0])) {
+                    found = false;
+                } else if (!found) {
+                    found = true;
+                    solution.time = info.time;
+                    solution.nodes = info.nodes;
+                }
+            });
+
+            std::atomic_bool aborted = false;
+            auto start = std::chrono::steady_clock::now();
+            search.enable_timer();
+            search_result_t result = search.think(board, options.limits(), aborted);
+            search.reset_timer();
+
+            solution.solved = result.best_move != EMPTY_MOVE && correct(result.best_move);
+            if (solution.solved && !found) {
+                solution.time = elapsed_ms(start);
+                solution.nodes = result.nodes;
+            }
+
+            auto id = position.operations.find("id");
+            std::lock_guard<std::mutex> lock(output_mtx);
+            solutions[index] = solution;
+            tested++;
+
+            std::cout << index << " " << (id == position.operations.end() ? "-" : id->second)
+                      << (solution.solved ? " solved" : " unsolved") << " bestmove " << result.best_move;
+            if (solution.solved) std::cout << " time " << solution.time << " nodes " << solution.nodes;
+            std::cout << std::endl;
+        });
+
+        // Summary
+        std::vector<solution_t> solved;
+        std::copy_if(solutions.begin(), solutions.end(), std::back_inserter(solved),
+                     [](const solution_t &solution) { return solution.solved; });
+        std::sort(solved.begin(), solved.end(), [](const solution_t &a, const solution_t &b) {
+            return a.time < b.time;
+        });
+
+        U64 total_time = 0, total_nodes = 0;
+        for (const solution_t &solution : solved) {
+            total_time += solution.time;
+            total_nodes += solution.nodes;
+        }
+
+        std::cout << "solved " << solved.size() << "/" << tested;
+        if (!solved.empty()) {
+            std::cout << " mean time " << total_time / solved.size() << " mean nodes " << total_nodes / solved.size();
+        }
+        std::cout << std::endl;
+
+        // Cumulative number of positions solved within 1, 2, 5, 10, 20, 50... milliseconds
+        U64 max_time = options.movetime != INT_MAX ? U64(options.movetime) : solved.empty() ? 0 : solved.back().time;
+        size_t count = 0;
+        for (U64 scale = 1, step = 0;; step++) {
+            U64 threshold = scale * (step % 3 == 0 ? 1 : step % 3 == 1 ? 2 : 5);
+            if (step % 3 == 2) scale *= 10;
+
+            while (count < solved.size() && solved[count].time <= threshold) count++;
+            std::cout << "time " << std::min(threshold, std::max<U64>(max_time, 1)) << " solved " << count << std::endl;
+            if (threshold >= max_time) break;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef TOPPLE_BATCH_H
+#define TOPPLE_BATCH_H
+
+namespace batch {
+    /**
+     * Analyse every position of an EPD or FEN file, one position per line, with a pool of independent single-threaded
+     * searches. Each result is written to standard output as soon as it is available, tagged with the index of the
+     * position in the file.
+     *
+     * Usage: Topple analyse <file> [--depth N] [--nodes N] [--movetime ms] [--jobs N] [--hash MB] [--shared-hash]
+     *                              [--format jsonl|csv] [--syzygy path]
+     *
+     * @param argc number of arguments following the mode
+     * @param argv arguments following the mode
+     * @return process exit code
+     */
+    int analyse(int argc, char *argv[]);
+
+    /**
+     * Run a test suite from an EPD file, using the same job pool as analysis mode. Positions must have a bm (best
+     * moves) or am (avoid moves) operation. For every solved position, the time and node count at which the best move
+     * last changed to a correct move are reported, followed by a summary and the cumulative number of positions
+     * solved over time. Searches default to one second per position.
+     *
+     * Usage: Topple suite <file> [--depth N] [--nodes N] [--movetime ms] [--jobs N] [--hash MB] [--shared-hash]
+     *                            [--syzygy path]
+     *
+     * @param argc number of arguments following the mode
+     * @param argv arguments following the mode
+     * @return process exit code
+     */
+    int suite(int argc, char *argv[]);
+}
+
+#endif //TOPPLE_BATCH_H
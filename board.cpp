@@ -11,11 +11,33 @@
 #include "board.h"
 #include "move.h"
 #include "hash.h"
+#include "attacks.h"
 
 void board_t::move(move_t move) {
+    record.back().next_move == WHITE ? this->move<WHITE>(move) : this->move<BLACK>(move);
+}
+
+void board_t::unmove() {
+    move_t move = record.back().prev_move;
+    sq_data_t captured = record.back().captured;
+    record.pop_back();
+
+    record.back().next_move == WHITE ? unmove<WHITE>(move, captured) : unmove<BLACK>(move, captured);
+}
+
+template<Team TEAM>
+void board_t::move(move_t move) {
+    constexpr Team X_TEAM = Team(!TEAM);
+
+    const Piece piece = moving_piece(move);
+    const bool ep = is_ep(move);
+    const sq_data_t captured = sq_data[move.info.to];
+
     // Insert a new record
     record.push_back(record.back());
     record.back().prev_move = move;
+    record.back().captured = move != EMPTY_MOVE ? captured : sq_data_t{};
+    record.back().dirty.count = 0;
 
     // Update side hash
     record.back().next_move = (Team) !record.back().next_move;
@@ -28,131 +50,124 @@ void board_t::move(move_t move) {
     }
 
     if (move != EMPTY_MOVE) {
-        auto team = Team(move.info.team);
-        auto x_team = Team(!move.info.team);
-
         // Update halfmove clock
-        if (move.info.piece == PAWN || move.info.is_capture) {
+        if (piece == PAWN || captured.occupied) {
             record.back().halfmove_clock = 0;
         } else {
             record.back().halfmove_clock++;
         }
 
-        if (move.info.is_capture && move.info.captured_type == ROOK) {
-            if (move.info.to == (x_team ? H8 : H1) && record.back().castle[x_team][0]) {
-                record.back().castle[x_team][0] = false;
-                record.back().hash ^= zobrist::castle[x_team][0];
-            } else if (move.info.to == (x_team ? A8 : A1) && record.back().castle[x_team][1]) {
-                record.back().castle[x_team][1] = false;
-                record.back().hash ^= zobrist::castle[x_team][1];
+        if (captured.occupied && captured.piece == ROOK) {
+            if (move.info.to == rel_sq(X_TEAM, H1) && record.back().castle[X_TEAM][0]) {
+                record.back().castle[X_TEAM][0] = false;
+                record.back().hash ^= zobrist::castle[X_TEAM][0];
+            } else if (move.info.to == rel_sq(X_TEAM, A1) && record.back().castle[X_TEAM][1]) {
+                record.back().castle[X_TEAM][1] = false;
+                record.back().hash ^= zobrist::castle[X_TEAM][1];
             }
         }
 
-        if (move.info.piece == PAWN) {
-            if (move.info.is_ep) {
+        if (piece == PAWN) {
+            if (ep) {
                 // Remove captured pawn
-                switch_piece<true>(x_team, PAWN, team ? move.info.to + uint8_t(8) : move.info.to - uint8_t(8));
-            } else if (move.info.is_capture) {
-                switch_piece<true>(x_team, (Piece) move.info.captured_type, move.info.to);
+                switch_piece<true>(X_TEAM, PAWN, move.info.to - rel_offset(TEAM, D_N));
+            } else if (captured.occupied) {
+                switch_piece<true>(X_TEAM, captured.piece, move.info.to);
             }
 
-            if (move.info.is_promotion) {
-                switch_piece<true>(team, (Piece) move.info.piece, move.info.from);
-                switch_piece<true>(team, (Piece) move.info.promotion_type, move.info.to);
+            if (is_promotion(move)) {
+                switch_piece<true>(TEAM, PAWN, move.info.from);
+                switch_piece<true>(TEAM, (Piece) move.info.promotion_type, move.info.to);
             } else {
-                switch_piece<true>(team, (Piece) move.info.piece, move.info.from);
-                switch_piece<true>(team, (Piece) move.info.piece, move.info.to);
+                switch_piece<true>(TEAM, PAWN, move.info.from);
+                switch_piece<true>(TEAM, PAWN, move.info.to);
             }
 
             // Update en-passant square
-            if (team ? move.info.to - move.info.from == -16 : move.info.to - move.info.from == 16) {
-                record.back().ep_square = team ? move.info.to + uint8_t(8) : move.info.to - uint8_t(8);
+            if (move.info.to - move.info.from == 2 * rel_offset(TEAM, D_N)) {
+                record.back().ep_square = move.info.to - rel_offset(TEAM, D_N);
                 record.back().hash ^= zobrist::ep[record.back().ep_square];
             }
         } else {
             // Update castling hashes for moving rook
-            if (move.info.piece == ROOK) {
-                if (team) {
-                    if (move.info.from == H8 && record.back().castle[team][0]) {
-                        record.back().hash ^= zobrist::castle[team][0];
-                        record.back().castle[team][0] = false;
-                    } else if (move.info.from == A8 && record.back().castle[team][1]) {
-                        record.back().hash ^= zobrist::castle[team][1];
-                        record.back().castle[team][1] = false;
-                    }
-                } else {
-                    if (move.info.from == H1 && record.back().castle[team][0]) {
-                        record.back().hash ^= zobrist::castle[team][0];
-                        record.back().castle[team][0] = false;
-                    } else if (move.info.from == A1 && record.back().castle[team][1]) {
-                        record.back().hash ^= zobrist::castle[team][1];
-                        record.back().castle[team][1] = false;
-                    }
+            if (piece == ROOK) {
+                if (move.info.from == rel_sq(TEAM, H1) && record.back().castle[TEAM][0]) {
+                    record.back().hash ^= zobrist::castle[TEAM][0];
+                    record.back().castle[TEAM][0] = false;
+                } else if (move.info.from == rel_sq(TEAM, A1) && record.back().castle[TEAM][1]) {
+                    record.back().hash ^= zobrist::castle[TEAM][1];
+                    record.back().castle[TEAM][1] = false;
                 }
-            } else if (move.info.piece == KING) {
+            } else if (piece == KING) {
                 // Update castling hashes
-                if (record.back().castle[team][0]) {
-                    record.back().hash ^= zobrist::castle[team][0];
-                    record.back().castle[team][0] = false;
+                if (record.back().castle[TEAM][0]) {
+                    record.back().hash ^= zobrist::castle[TEAM][0];
+                    record.back().castle[TEAM][0] = false;
                 }
-                if (record.back().castle[team][1]) {
-                    record.back().hash ^= zobrist::castle[team][1];
-                    record.back().castle[team][1] = false;
+                if (record.back().castle[TEAM][1]) {
+                    record.back().hash ^= zobrist::castle[TEAM][1];
+                    record.back().castle[TEAM][1] = false;
                 }
 
-                if (move.info.castle) {
+                if (move.info.to == move.info.from + 2) {
                     // Move rook
-                    switch_piece<true>(team, ROOK,
-                                       move.info.castle_side ? (team ? A8 : A1) : (team ? H8 : H1));
-                    switch_piece<true>(team, ROOK,
-                                       move.info.castle_side ? (team ? D8 : D1) : (team ? F8 : F1));
+                    switch_piece<true>(TEAM, ROOK, rel_sq(TEAM, H1));
+                    switch_piece<true>(TEAM, ROOK, rel_sq(TEAM, F1));
+                } else if (move.info.to + 2 == move.info.from) {
+                    switch_piece<true>(TEAM, ROOK, rel_sq(TEAM, A1));
+                    switch_piece<true>(TEAM, ROOK, rel_sq(TEAM, D1));
                 }
             }
 
-            if (move.info.is_capture) {
-                switch_piece<true>(x_team, (Piece) move.info.captured_type, move.info.to);
+            if (captured.occupied) {
+                switch_piece<true>(X_TEAM, captured.piece, move.info.to);
             }
-            switch_piece<true>(team, (Piece) move.info.piece, move.info.from);
-            switch_piece<true>(team, (Piece) move.info.piece, move.info.to);
+            switch_piece<true>(TEAM, piece, move.info.from);
+            switch_piece<true>(TEAM, piece, move.info.to);
         }
     }
 }
 
-void board_t::unmove() {
-    move_t move = record.back().prev_move;
-    record.pop_back();
+template<Team TEAM>
+void board_t::unmove(move_t move, sq_data_t captured) {
+    constexpr Team X_TEAM = Team(!TEAM);
 
     if (move != EMPTY_MOVE) {
-        if (move.info.piece == PAWN) {
-            if (move.info.is_promotion) {
-                switch_piece<false>((Team) move.info.team, (Piece) move.info.piece, move.info.from);
-                switch_piece<false>((Team) move.info.team, (Piece) move.info.promotion_type, move.info.to);
+        // The record has already been popped, so the en passant square is restored
+        const Piece piece = is_promotion(move) ? PAWN : sq_data[move.info.to].piece;
+
+        if (piece == PAWN) {
+            if (is_promotion(move)) {
+                switch_piece<false>(TEAM, PAWN, move.info.from);
+                switch_piece<false>(TEAM, (Piece) move.info.promotion_type, move.info.to);
             } else {
-                switch_piece<false>((Team) move.info.team, (Piece) move.info.piece, move.info.from);
-                switch_piece<false>((Team) move.info.team, (Piece) move.info.piece, move.info.to);
+                switch_piece<false>(TEAM, PAWN, move.info.from);
+                switch_piece<false>(TEAM, PAWN, move.info.to);
             }
 
-            if (move.info.is_ep) {
+            if (move.info.to == record.back().ep_square && record.back().ep_square != 0) {
                 // Replace captured pawn
-                switch_piece<false>((Team) !move.info.team, PAWN,
-                                    move.info.team ? move.info.to + uint8_t(8) : move.info.to - uint8_t(8));
-            } else if (move.info.is_capture) {
-                switch_piece<false>((Team) !move.info.team, (Piece) move.info.captured_type, move.info.to);
+                switch_piece<false>(X_TEAM, PAWN, move.info.to - rel_offset(TEAM, D_N));
+            } else if (captured.occupied) {
+                switch_piece<false>(X_TEAM, captured.piece, move.info.to);
             }
         } else {
-            if (move.info.castle) {
-                // Move rook
-                switch_piece<false>((Team) move.info.team, ROOK,
-                                    move.info.castle_side ? (move.info.team ? A8 : A1) : (move.info.team ? H8 : H1));
-                switch_piece<false>((Team) move.info.team, ROOK,
-                                    move.info.castle_side ? (move.info.team ? D8 : D1) : (move.info.team ? F8 : F1));
+            if (piece == KING) {
+                if (move.info.to == move.info.from + 2) {
+                    // Move rook
+                    switch_piece<false>(TEAM, ROOK, rel_sq(TEAM, H1));
+                    switch_piece<false>(TEAM, ROOK, rel_sq(TEAM, F1));
+                } else if (move.info.to + 2 == move.info.from) {
+                    switch_piece<false>(TEAM, ROOK, rel_sq(TEAM, A1));
+                    switch_piece<false>(TEAM, ROOK, rel_sq(TEAM, D1));
+                }
             }
 
-            switch_piece<false>((Team) move.info.team, (Piece) move.info.piece, move.info.from);
-            switch_piece<false>((Team) move.info.team, (Piece) move.info.piece, move.info.to);
+            switch_piece<false>(TEAM, piece, move.info.from);
+            switch_piece<false>(TEAM, piece, move.info.to);
 
-            if (move.info.is_capture) {
-                switch_piece<false>((Team) !move.info.team, (Piece) move.info.captured_type, move.info.to);
+            if (captured.occupied) {
+                switch_piece<false>(X_TEAM, captured.piece, move.info.to);
             }
         }
     }
@@ -279,79 +294,44 @@ board_t::board_t(const std::string &fen) {
 //  - if the piece actually exists
 // If the move cannot be parsed, 0000 is returned
 move_t board_t::parse_move(const std::string &str) const {
-    packed_move_t packed_move = {};
+    move_t move = EMPTY_MOVE;
 
     if (str.length() != 4 && str.length() != 5) {
         return EMPTY_MOVE;
     }
     
     try {
-        packed_move.from = to_sq(str[0], str[1]);
-        packed_move.to = to_sq(str[2], str[3]);
+        move.info.from = to_sq(str[0], str[1]);
+        move.info.to = to_sq(str[2], str[3]);
     } catch (std::runtime_error &e) {
         return EMPTY_MOVE;
     }
     
     if(str.length() == 5) {
+        Piece type;
         switch (str[4]) {
             case 'n':
-                packed_move.type = KNIGHT;
+                type = KNIGHT;
                 break;
             case 'b':
-                packed_move.type = BISHOP;
+                type = BISHOP;
                 break;
             case 'r':
-                packed_move.type = ROOK;
+                type = ROOK;
                 break;
             case 'q':
-                packed_move.type = QUEEN;
+                type = QUEEN;
                 break;
             default:
                 return EMPTY_MOVE;
         }
-    }
 
-    return to_move(packed_move);
-}
-
-move_t board_t::to_move(packed_move_t packed_move) const {
-    move_t move{};
-    
-    move.info.from = static_cast<uint8_t>(packed_move.from);
-    move.info.to = static_cast<uint8_t>(packed_move.to);
-    
-    // Piece
-    move.info.team = sq_data[move.info.from].team;
-    move.info.piece = sq_data[move.info.from].piece;
-
-    // Capture
-    move.info.is_capture = static_cast<uint16_t>(sq_data[move.info.to].occupied);
-    move.info.captured_type = sq_data[move.info.to].occupied ? sq_data[move.info.to].piece : 0;
-
-    // Promotion
-    move.info.is_promotion = static_cast<uint16_t>(packed_move.type != 0 && (move.info.to <= H1 || move.info.to >= A8));
-    if (move.info.is_promotion) {
-        move.info.promotion_type = packed_move.type;
-    }
-
-    // Castling
-    if (move.info.piece == KING) {
-        if (move.info.from == E1 || move.info.from == E8) {
-            if (move.info.to == G1 || move.info.to == G8) {
-                move.info.castle = 1;
-                move.info.castle_side = 0;
-            } else if (move.info.to == C1 || move.info.to == C8) {
-                move.info.castle = 1;
-                move.info.castle_side = 1;
-            }
+        // Promotions are only possible on the last rank
+        if (move.info.to <= H1 || move.info.to >= A8) {
+            move.info.promotion_type = type;
         }
     }
 
-    // EP
-    move.info.is_capture |= move.info.is_ep = static_cast<uint16_t>(record.back().ep_square != 0
-                                            && move.info.piece == PAWN
-                                            && move.info.to == record.back().ep_square);
-
     return move;
 }
 
@@ -389,9 +369,15 @@ void board_t::switch_piece(Team side, Piece piece, uint8_t sq) {
     if (HASH) { // Update hash
         U64 square_hash = zobrist::squares[sq][side][piece];
         record.back().hash ^= square_hash;
-        if(piece == PAWN || piece == KING) record.back().kp_hash ^= square_hash;
+        if(piece == PAWN) record.back().pawn_hash ^= square_hash;
         if(sq_data[sq].occupied) record.back().material.info.inc(side, piece);
         else record.back().material.info.dec(side, piece);
+
+        dirty_pieces_t &dirty = record.back().dirty;
+        if (dirty.count < dirty_pieces_t::MAX_CHANGES) {
+            dirty.changes[dirty.count] = {sq, side, piece, sq_data[sq].occupied};
+        }
+        if (dirty.count <= dirty_pieces_t::MAX_CHANGES) dirty.count++;
     }
 }
 
@@ -427,14 +413,18 @@ bool board_t::is_attacked(uint8_t sq, Team side, U64 occupied) const {
 bool board_t::is_pseudo_legal(move_t move) const {
     if (move == EMPTY_MOVE) return false;
 
-    auto team = Team(move.info.team);
-    auto x_team = Team(!move.info.team);
+    auto team = record.back().next_move;
+    auto x_team = Team(!team);
 
-    if (record.back().next_move != team) return false;
+    // Own piece on the origin square, and none on the destination square
+    if (!(bb_side[team] & single_bit(move.info.from)) || (bb_side[team] & single_bit(move.info.to))) return false;
 
-    if (move.info.castle) {
-        if (record.back().castle[move.info.team][move.info.castle_side] == 0) return false;
-        if (move.info.castle_side == 0) {
+    Piece piece = moving_piece(move);
+
+    if (is_castle(move)) {
+        bool castle_side = move.info.to < move.info.from;
+        if (record.back().castle[team][castle_side] == 0) return false;
+        if (castle_side == 0) {
             return (bb_all & bits_between(team ? E8 : E1, team ? H8 : H1)) == 0 &&
                    !is_attacked(team ? E8 : E1, x_team) &&
                    !is_attacked(team ? F8 : F1, x_team) &&
@@ -447,57 +437,51 @@ bool board_t::is_pseudo_legal(move_t move) const {
         }
     }
 
-    if (move.info.is_capture && !move.info.is_ep) {
-        if ((bb_pieces[x_team][move.info.captured_type] & single_bit(move.info.to)) == 0) return false;
-    } else {
-        if ((bb_side[x_team] & single_bit(move.info.to)) != 0) return false;
-    }
-
-    if(move.info.is_ep) {
-        if(record.back().ep_square == 0 || move.info.to != record.back().ep_square) {
+    if(is_ep(move)) {
+        if ((find_moves<PAWN>(team, move.info.from, bb_all | single_bit(move.info.to)) & single_bit(move.info.to)) == 0) {
             return false;
         }
     } else {
-        if ((find_moves(Piece(move.info.piece), team, move.info.from, bb_all) & single_bit(move.info.to)) == 0) {
+        if ((find_moves(piece, team, move.info.from, bb_all) & single_bit(move.info.to)) == 0) {
             return false;
         }
     }
 
-    if(move.info.piece == PAWN) {
-        if ((move.info.to <= H1 || move.info.to >= A8) == !move.info.is_promotion) return false;
+    if(piece == PAWN) {
+        if ((move.info.to <= H1 || move.info.to >= A8) == !is_promotion(move)) return false;
+        if (is_promotion(move) && (move.info.promotion_type < KNIGHT || move.info.promotion_type > QUEEN)) return false;
     } else {
-        if (move.info.is_promotion) return false;
+        if (is_promotion(move)) return false;
     }
 
-    return (bb_pieces[team][move.info.piece] & single_bit(move.info.from)) &&
-           !(bb_side[team] & single_bit(move.info.to));
+    return true;
 }
 
 // Assumes the move is pseudo-legal
 bool board_t::is_legal(move_t move) const {
-    Team side = Team(move.info.team);
+    Team side = moving_team(move);
     Team x_side = Team(!side);
     uint8_t king_square = bit_scan(bb_pieces[side][KING]);
 
     U64 checkers = attacks_to(king_square, side);
     if(checkers != 0) {
-        if(move.info.piece == KING) {
+        if(moving_piece(move) == KING) {
             U64 occupied = bb_all ^ single_bit(move.info.from);
-            if(!move.info.is_capture) occupied ^= single_bit(move.info.to);
+            if(!is_capture(move)) occupied ^= single_bit(move.info.to);
 
             return !is_attacked(move.info.to, x_side, occupied);
         } else {
             U64 occupied = bb_all ^ single_bit(move.info.from);
-            if(move.info.is_ep) {
-                if((checkers ^ single_bit(uint8_t(rel_offset(Team(move.info.team), D_S) + move.info.to))) == 0) {
-                    occupied ^= single_bit(uint8_t(rel_offset(Team(move.info.team), D_S) + move.info.to))
+            if(is_ep(move)) {
+                if((checkers ^ single_bit(uint8_t(rel_offset(side, D_S) + move.info.to))) == 0) {
+                    occupied ^= single_bit(uint8_t(rel_offset(side, D_S) + move.info.to))
                             | single_bit(move.info.to);
                     return !(find_moves<BISHOP>(side, king_square, occupied) & (bb_pieces[x_side][BISHOP] | bb_pieces[x_side][QUEEN]))
                            && !(find_moves<ROOK>(side, king_square, occupied) & (bb_pieces[x_side][ROOK] | bb_pieces[x_side][QUEEN]));
                 } else {
                     return false;
                 }
-            } if(move.info.is_capture && (checkers ^ single_bit(move.info.to)) == 0) {
+            } if(is_capture(move) && (checkers ^ single_bit(move.info.to)) == 0) {
                 return !(find_moves<BISHOP>(side, king_square, occupied) & (bb_pieces[x_side][BISHOP] | bb_pieces[x_side][QUEEN]) & ~checkers)
                        && !(find_moves<ROOK>(side, king_square, occupied) & (bb_pieces[x_side][ROOK] | bb_pieces[x_side][QUEEN]) & ~checkers);
             } else {
@@ -506,15 +490,15 @@ bool board_t::is_legal(move_t move) const {
             }
         }
     } else {
-        if(move.info.piece == KING) {
+        if(moving_piece(move) == KING) {
             return !is_attacked(move.info.to, x_side);
         } else {
             U64 occupied = bb_all ^ single_bit(move.info.from);
             U64 captured = 0;
-            if (move.info.is_ep) {
-                occupied ^= single_bit(uint8_t(rel_offset(Team(move.info.team), D_S) + move.info.to));
+            if (is_ep(move)) {
+                occupied ^= single_bit(uint8_t(rel_offset(side, D_S) + move.info.to));
                 occupied ^= single_bit(move.info.to);
-            } else if (!move.info.is_capture) {
+            } else if (!is_capture(move)) {
                 occupied ^= single_bit(move.info.to);
             } else {
                 captured ^= single_bit(move.info.to);
@@ -526,28 +510,104 @@ bool board_t::is_legal(move_t move) const {
     }
 }
 
+U64 board_t::key_after(move_t move) const {
+    const game_record_t &current = record.back();
+    U64 key = current.hash ^ zobrist::side;
+    if (current.ep_square != 0) key ^= zobrist::ep[current.ep_square];
+    if (move == EMPTY_MOVE) return key;
+
+    Team side = moving_team(move);
+    Team x_side = Team(!side);
+    Piece piece = moving_piece(move);
+
+    key ^= zobrist::squares[move.info.from][side][piece];
+    key ^= zobrist::squares[move.info.to][side][is_promotion(move) ? Piece(move.info.promotion_type) : piece];
+
+    if (is_ep(move)) {
+        key ^= zobrist::squares[move.info.to - rel_offset(side, D_N)][x_side][PAWN];
+    } else if (is_capture(move)) {
+        key ^= zobrist::squares[move.info.to][x_side][captured_piece(move)];
+
+        // Capturing a rook on its original square
+        if (captured_piece(move) == ROOK) {
+            if (move.info.to == rel_sq(x_side, H1) && current.castle[x_side][0]) {
+                key ^= zobrist::castle[x_side][0];
+            } else if (move.info.to == rel_sq(x_side, A1) && current.castle[x_side][1]) {
+                key ^= zobrist::castle[x_side][1];
+            }
+        }
+    }
+
+    if (piece == PAWN) {
+        if (move.info.to - move.info.from == 2 * rel_offset(side, D_N)) {
+            key ^= zobrist::ep[move.info.to - rel_offset(side, D_N)];
+        }
+    } else if (piece == ROOK) {
+        if (move.info.from == rel_sq(side, H1) && current.castle[side][0]) {
+            key ^= zobrist::castle[side][0];
+        } else if (move.info.from == rel_sq(side, A1) && current.castle[side][1]) {
+            key ^= zobrist::castle[side][1];
+        }
+    } else if (piece == KING) {
+        if (current.castle[side][0]) key ^= zobrist::castle[side][0];
+        if (current.castle[side][1]) key ^= zobrist::castle[side][1];
+
+        if (move.info.to == move.info.from + 2) {
+            key ^= zobrist::squares[rel_sq(side, H1)][side][ROOK];
+            key ^= zobrist::squares[rel_sq(side, F1)][side][ROOK];
+        } else if (move.info.to + 2 == move.info.from) {
+            key ^= zobrist::squares[rel_sq(side, A1)][side][ROOK];
+            key ^= zobrist::squares[rel_sq(side, D1)][side][ROOK];
+        }
+    }
+
+    return key;
+}
+
+U64 board_t::pawn_key_after(move_t move) const {
+    U64 key = record.back().pawn_hash;
+    if (move == EMPTY_MOVE) return key;
+
+    Team side = moving_team(move);
+    Team x_side = Team(!side);
+
+    if (moving_piece(move) == PAWN) {
+        key ^= zobrist::squares[move.info.from][side][PAWN];
+        if (!is_promotion(move)) key ^= zobrist::squares[move.info.to][side][PAWN];
+    }
+
+    if (is_ep(move)) {
+        key ^= zobrist::squares[move.info.to - rel_offset(side, D_N)][x_side][PAWN];
+    } else if (sq_data[move.info.to].occupied && sq_data[move.info.to].piece == PAWN) {
+        key ^= zobrist::squares[move.info.to][x_side][PAWN];
+    }
+
+    return key;
+}
+
 // Assumes the move is both pseudo legal and legal
 bool board_t::gives_check(move_t move) const {
-    Team side = Team(move.info.team);
-    Team x_side = Team(!move.info.team);
+    Team side = moving_team(move);
+    Team x_side = Team(!side);
     uint8_t king_square = bit_scan(bb_pieces[x_side][KING]);
 
-    if(find_moves(Piece(move.info.piece), side, move.info.to, bb_all) & bb_pieces[x_side][KING]) {
+    if(find_moves(moving_piece(move), side, move.info.to, bb_all) & bb_pieces[x_side][KING]) {
         return true;
-    } else if(move.info.castle) {
+    } else if(is_castle(move)) {
+        bool castle_side = move.info.to < move.info.from;
         U64 occupied = bb_all ^ single_bit(move.info.from) ^ single_bit(move.info.to);
         return (find_moves<ROOK>(side,
-                                 side ? (move.info.castle_side ? D8 : F8) : (move.info.castle_side ? D1 : F1), occupied)
+                                 side ? (castle_side ? D8 : F8) : (castle_side ? D1 : F1), occupied)
                 & bb_pieces[x_side][KING]) != 0;
-    } else if (move.info.is_promotion && (find_moves(Piece(move.info.promotion_type), side, move.info.to,
+    } else if (is_promotion(move) && (find_moves(Piece(move.info.promotion_type), side, move.info.to,
             (bb_all ^ single_bit(move.info.from)) | single_bit(move.info.to)) & bb_pieces[x_side][KING])) {
         return true;
     } else {
         U64 occupied = bb_all ^ single_bit(move.info.from);
-        if (move.info.is_ep) {
-            occupied ^= single_bit(uint8_t(rel_offset(Team(move.info.team), D_S) + move.info.to));
+        if (is_ep(move)) {
+            occupied ^= single_bit(uint8_t(rel_offset(side, D_S) + move.info.to));
             occupied ^= single_bit(move.info.to);
-        } else if (!move.info.is_capture) {
+        } else if (!is_capture(move)) {
             occupied ^= single_bit(move.info.to);
         }
 
@@ -559,7 +619,7 @@ bool board_t::gives_check(move_t move) const {
 bool board_t::is_repetition_draw(int search_ply) const {
     int rep = 1;
 
-    int max = record.back().halfmove_clock;
+    int max = std::min<int>(record.back().halfmove_clock, int(record.size()) - 1);
 
     for (int i = 2; i <= max; i += 2) {
         if (record.crbegin()[i].hash == record.back().hash) rep++;
@@ -570,6 +630,33 @@ bool board_t::is_repetition_draw(int search_ply) const {
     return false;
 }
 
+// Returns the number of plies back to the nearest earlier position that the side to move can return to with a single
+// reversible move, or 0 if there is none. Positions an even number of plies back have the same side to move, so only
+// odd distances are considered. The move may still be illegal if it leaves the king in check.
+int board_t::upcoming_repetition() const {
+    int max = std::min<int>(record.back().halfmove_clock, int(record.size()) - 1);
+
+    for (int i = 3; i <= max; i += 2) {
+        U64 key = record.back().hash ^ record.crbegin()[i].hash;
+
+        size_t index = zobrist::cuckoo_h1(key);
+        if (zobrist::cuckoo[index] != key) {
+            index = zobrist::cuckoo_h2(key);
+            if (zobrist::cuckoo[index] != key) continue;
+        }
+
+        uint8_t a = zobrist::cuckoo_squares[index][0];
+        uint8_t b = zobrist::cuckoo_squares[index][1];
+        if (bb_util::between[a][b] & bb_all) continue;
+
+        // The piece must belong to the side to move
+        uint8_t sq = sq_data[a].occupied ? a : b;
+        if (sq_data[sq].team == record.back().next_move) return i;
+    }
+
+    return 0;
+}
+
 bool board_t::is_material_draw() const {
     if(record.back().material.info.w_pawns || record.back().material.info.b_pawns ||
              record.back().material.info.w_queens || record.back().material.info.b_queens ||
@@ -617,15 +704,15 @@ void board_t::mirror() {
 }
 
 int board_t::see(move_t move) const {
-    if(move == EMPTY_MOVE || move.info.is_ep)
+    if(move == EMPTY_MOVE || is_ep(move))
         return 0;
 
     // State
-    U64 attackers = attacks_to(move.info.to, Team(move.info.team)) | attacks_to(move.info.to, Team(!move.info.team));
+    U64 attackers = attacks_to(move.info.to, WHITE) | attacks_to(move.info.to, BLACK);
     U64 occupation_mask = ONES;
     int current_target_val = 0;
     bool prom_rank = rank_index(move.info.to) == 0 || rank_index(move.info.to) == 7;
-    auto next_move = Team(move.info.team);
+    auto next_move = moving_team(move);
 
     // Material table
     int num_capts = 0;
@@ -633,8 +720,8 @@ int board_t::see(move_t move) const {
 
     // Eval move
     material[num_capts] = sq_data[move.info.to].occupied ? VAL[sq_data[move.info.to].piece] : 0;
-    current_target_val = VAL[move.info.piece];
-    if (prom_rank && move.info.piece == PAWN) {
+    current_target_val = VAL[moving_piece(move)];
+    if (prom_rank && moving_piece(move) == PAWN) {
         material[num_capts] += VAL[move.info.promotion_type] - VAL[PAWN];
         current_target_val += VAL[move.info.promotion_type] - VAL[PAWN];
     }
@@ -645,35 +732,13 @@ int board_t::see(move_t move) const {
     occupation_mask &= ~single_bit(move.info.from);
 
     // Reveal next attacker
-    attackers |= (find_moves<QUEEN>(next_move, move.info.to, bb_all & occupation_mask)
-                  & (bb_pieces[WHITE][QUEEN] | bb_pieces[BLACK][QUEEN])) |
-                 (find_moves<BISHOP>(next_move, move.info.to, bb_all & occupation_mask)
-                  & (bb_pieces[WHITE][BISHOP] | bb_pieces[BLACK][BISHOP])) |
-                 (find_moves<ROOK>(next_move, move.info.to, bb_all & occupation_mask)
-                  & (bb_pieces[WHITE][ROOK] | bb_pieces[BLACK][ROOK]));
+    attackers |= see_xrays(move.info.to, bb_all & occupation_mask);
     attackers &= occupation_mask;
 
     next_move = Team(!next_move);
 
-    while (attackers) {
-        // Pick LVA
-        Square from;
-        if (!prom_rank && attackers & bb_pieces[next_move][PAWN])
-            from = Square(bit_scan(attackers & bb_pieces[next_move][PAWN]));
-        else if (attackers & bb_pieces[next_move][KNIGHT])
-            from = Square(bit_scan(attackers & bb_pieces[next_move][KNIGHT]));
-        else if (attackers & bb_pieces[next_move][BISHOP])
-            from = Square(bit_scan(attackers & bb_pieces[next_move][BISHOP]));
-        else if (attackers & bb_pieces[next_move][ROOK])
-            from = Square(bit_scan(attackers & bb_pieces[next_move][ROOK]));
-        else if (prom_rank && attackers & bb_pieces[next_move][PAWN])
-            from = Square(bit_scan(attackers & bb_pieces[next_move][PAWN]));
-        else if (attackers & bb_pieces[next_move][QUEEN])
-            from = Square(bit_scan(attackers & bb_pieces[next_move][QUEEN]));
-        else if (attackers & bb_pieces[next_move][KING] && !(attackers & bb_side[!next_move]))
-            from = Square(bit_scan(attackers & bb_pieces[next_move][KING]));
-        else break;
-
+    uint8_t from;
+    while (see_attacker(attackers, next_move, prom_rank, from)) {
         // Eval move
         material[num_capts] = -material[num_capts - 1] + current_target_val;
         current_target_val = VAL[sq_data[from].piece];
@@ -688,12 +753,7 @@ int board_t::see(move_t move) const {
         occupation_mask &= ~single_bit(from);
 
         // Reveal next attacker
-        attackers |= (find_moves<QUEEN>(next_move, move.info.to, bb_all & occupation_mask)
-                      & (bb_pieces[WHITE][QUEEN] | bb_pieces[BLACK][QUEEN])) |
-                     (find_moves<BISHOP>(next_move, move.info.to, bb_all & occupation_mask)
-                      & (bb_pieces[WHITE][BISHOP] | bb_pieces[BLACK][BISHOP])) |
-                     (find_moves<ROOK>(next_move, move.info.to, bb_all & occupation_mask)
-                      & (bb_pieces[WHITE][ROOK] | bb_pieces[BLACK][ROOK]));
+        attackers |= see_xrays(move.info.to, bb_all & occupation_mask);
         attackers &= occupation_mask;
 
         next_move = Team(!next_move);
@@ -707,6 +767,127 @@ int board_t::see(move_t move) const {
     return material[0];
 }
 
+// Equivalent to see(move) >= threshold, but stops as soon as the result is known. Each side in turn may stop the
+// exchange, so the side which moved stops once the balance reaches the threshold, and the other side stops once it is
+// below the threshold. Unless a recapture can promote, the exchange is also decided if recapturing the piece on the
+// square cannot change which side of the threshold the balance is on, without looking for any attackers.
+bool board_t::see_ge(move_t move, int threshold) const {
+    if(move == EMPTY_MOVE || is_ep(move))
+        return 0 >= threshold;
+
+    const Team team = moving_team(move);
+    bool prom_rank = rank_index(move.info.to) == 0 || rank_index(move.info.to) == 7;
+
+    // Balance for the side which moved, and value of the piece that can be captured next
+    int balance = sq_data[move.info.to].occupied ? VAL[sq_data[move.info.to].piece] : 0;
+    int target_val = VAL[moving_piece(move)];
+    if (prom_rank && moving_piece(move) == PAWN) {
+        balance += VAL[move.info.promotion_type] - VAL[PAWN];
+        target_val += VAL[move.info.promotion_type] - VAL[PAWN];
+    }
+
+    if (balance < threshold) return false;
+    if (!prom_rank && balance - target_val >= threshold) return true;
+
+    // Remove attacker, and reveal next attacker
+    U64 occupation_mask = ~single_bit(move.info.from);
+    U64 attackers = (attacks_to(move.info.to, WHITE) | attacks_to(move.info.to, BLACK)
+                     | see_xrays(move.info.to, bb_all & occupation_mask)) & occupation_mask;
+
+    auto next_move = Team(!team);
+
+    uint8_t from;
+    while (see_attacker(attackers, next_move, prom_rank, from)) {
+        // Capture, and the value the capturing piece puts on the square
+        int gain = target_val;
+        target_val = VAL[sq_data[from].piece];
+        if (prom_rank && sq_data[from].piece == PAWN) {
+            gain += VAL[QUEEN] - VAL[PAWN];
+            target_val = VAL[QUEEN] - VAL[PAWN];
+        }
+        balance += next_move == team ? gain : -gain;
+
+        next_move = Team(!next_move);
+
+        // The side to move stops if it can
+        if (next_move == team) {
+            if (balance >= threshold) return true;
+            if (!prom_rank && balance + target_val < threshold) return false;
+        } else {
+            if (balance < threshold) return false;
+            if (!prom_rank && balance - target_val >= threshold) return true;
+        }
+
+        // Remove attacker, and reveal next attacker
+        attackers &= ~single_bit(from);
+        occupation_mask &= ~single_bit(from);
+        attackers |= see_xrays(move.info.to, bb_all & occupation_mask);
+        attackers &= occupation_mask;
+    }
+
+    // The side to move has run out of attackers, so the exchange has stopped
+    return next_move != team;
+}
+
+int board_t::see(move_t move, const attack_map_t &attacks) const {
+    return see_undefended(move, attacks) ? see_gain(move) : see(move);
+}
+
+bool board_t::see_ge(move_t move, int threshold, const attack_map_t &attacks) const {
+    return see_undefended(move, attacks) ? see_gain(move) >= threshold : see_ge(move, threshold);
+}
+
+// Whether the opponent has no piece to recapture with, either attacking the target square already or revealed behind
+// the moving piece. A slider can only be revealed if it attacks the moving piece, so the map rules most of them out.
+bool board_t::see_undefended(move_t move, const attack_map_t &attacks) const {
+    if (move == EMPTY_MOVE || is_ep(move)) return false;
+
+    Team x_team = Team(!moving_team(move));
+    if (attacks.sides[x_team] & single_bit(move.info.to)) return false;
+
+    U64 x_sliders = attacks.pieces[x_team][BISHOP] | attacks.pieces[x_team][ROOK] | attacks.pieces[x_team][QUEEN];
+    return (x_sliders & single_bit(move.info.from)) == 0
+           || (see_xrays(move.info.to, bb_all & ~single_bit(move.info.from)) & bb_side[x_team]) == 0;
+}
+
+// Material won by a move that cannot be answered by a recapture
+int board_t::see_gain(move_t move) const {
+    int gain = sq_data[move.info.to].occupied ? VAL[sq_data[move.info.to].piece] : 0;
+    if (is_promotion(move)) gain += VAL[move.info.promotion_type] - VAL[PAWN];
+    return gain;
+}
+
+// Finds the least valuable attacker of a side, for SEE. Pawns on the promotion rank are considered as queens, and the
+// king may only capture if the square is not defended.
+bool board_t::see_attacker(U64 attackers, Team side, bool prom_rank, uint8_t &from) const {
+    if (!prom_rank && attackers & bb_pieces[side][PAWN])
+        from = bit_scan(attackers & bb_pieces[side][PAWN]);
+    else if (attackers & bb_pieces[side][KNIGHT])
+        from = bit_scan(attackers & bb_pieces[side][KNIGHT]);
+    else if (attackers & bb_pieces[side][BISHOP])
+        from = bit_scan(attackers & bb_pieces[side][BISHOP]);
+    else if (attackers & bb_pieces[side][ROOK])
+        from = bit_scan(attackers & bb_pieces[side][ROOK]);
+    else if (prom_rank && attackers & bb_pieces[side][PAWN])
+        from = bit_scan(attackers & bb_pieces[side][PAWN]);
+    else if (attackers & bb_pieces[side][QUEEN])
+        from = bit_scan(attackers & bb_pieces[side][QUEEN]);
+    else if (attackers & bb_pieces[side][KING] && !(attackers & bb_side[!side]))
+        from = bit_scan(attackers & bb_pieces[side][KING]);
+    else
+        return false;
+
+    return true;
+}
+
+// Sliding attackers of a square, through the given occupancy
+U64 board_t::see_xrays(uint8_t sq, U64 occupied) const {
+    return (find_moves<BISHOP>(WHITE, sq, occupied)
+            & (bb_pieces[WHITE][BISHOP] | bb_pieces[BLACK][BISHOP] | bb_pieces[WHITE][QUEEN] | bb_pieces[BLACK][QUEEN]))
+           | (find_moves<ROOK>(WHITE, sq, occupied)
+              & (bb_pieces[WHITE][ROOK] | bb_pieces[BLACK][ROOK] | bb_pieces[WHITE][QUEEN] | bb_pieces[BLACK][QUEEN]));
+}
+
 U64 board_t::non_pawn_material(Team side) const {
     return (bb_side[side] ^ bb_pieces[side][PAWN] ^ bb_pieces[side][KING]);
 }
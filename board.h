@@ -6,6 +6,7 @@
 #define TOPPLE_BOARD_H
 
 #include <string>
+#include <vector>
 #include <iostream>
 
 #include "move.h"
@@ -17,30 +18,53 @@
 // Used for SEE
 constexpr int VAL[] = {100, 300, 300, 500, 900, INF};
 
+/**
+ * Pieces added to and removed from the board by the move which reached a state, so that evaluation can be updated
+ * incrementally. If more than MAX_CHANGES pieces were switched (e.g. when setting up a position), the changes are not
+ * recorded, and count is MAX_CHANGES + 1.
+ */
+struct dirty_pieces_t {
+    static constexpr uint8_t MAX_CHANGES = 4;
+
+    struct change_t {
+        uint8_t square;
+        Team team : 1;
+        Piece piece : 3;
+        bool added : 1;
+    };
+
+    uint8_t count;
+    change_t changes[MAX_CHANGES];
+};
+
+struct sq_data_t {
+    bool occupied : 1;
+    Team team : 1;
+    Piece piece : 6;
+};
+
 /**
  * Represents a state in the game. It contains the move used to reach the state, and necessary variables within the state.
  */
 struct game_record_t {
     move_t prev_move;
+    sq_data_t captured; // Contents of the destination square of prev_move before it was made
 
     Team next_move; // Who moves next?
     bool castle[2][2]; // [Team][0 for kingside, 1 for queenside]
     uint8_t ep_square; // Target square for en-passant after last double pawn move
     int halfmove_clock; // Moves since last pawn move or capture
     U64 hash;
-    U64 kp_hash;
+    U64 pawn_hash;
     material_data_t material;
+    dirty_pieces_t dirty;
 };
 
 /**
  * Represents the attacks on a certain square on the board. The team and piece fields are only meaningful if the
  * square is occupied - the occupied field is true.
  */
-struct sq_data_t {
-    bool occupied : 1;
-    Team team : 1;
-    Piece piece : 6;
-};
+struct attack_map_t;
 
 /**
  * Internal board representation used in the Topple engine.
@@ -54,7 +78,38 @@ struct alignas(64) board_t {
     void unmove();
 
     move_t parse_move(const std::string &str) const;
-    move_t to_move(packed_move_t packed_move) const;
+
+    // Properties of a move in the current position, which are not stored in the move itself
+    Team moving_team(move_t move) const {
+        return sq_data[move.info.from].team;
+    }
+
+    Piece moving_piece(move_t move) const {
+        return sq_data[move.info.from].piece;
+    }
+
+    bool is_ep(move_t move) const {
+        return move.info.to == record.back().ep_square && record.back().ep_square != 0
+               && sq_data[move.info.from].piece == PAWN;
+    }
+
+    bool is_capture(move_t move) const {
+        return sq_data[move.info.to].occupied || is_ep(move);
+    }
+
+    // Type of the captured piece, or PAWN if the move is not a capture
+    Piece captured_piece(move_t move) const {
+        return sq_data[move.info.to].occupied ? sq_data[move.info.to].piece : PAWN;
+    }
+
+    bool is_castle(move_t move) const {
+        return sq_data[move.info.from].piece == KING && (move.info.to == move.info.from + 2 || move.info.to + 2 == move.info.from);
+    }
+
+    // Neither a capture, a promotion nor castling
+    bool is_quiet(move_t move) const {
+        return !is_capture(move) && !is_promotion(move) && !is_castle(move);
+    }
 
     bool is_illegal() const;
     bool is_incheck() const;
@@ -66,10 +121,21 @@ struct alignas(64) board_t {
     bool is_legal(move_t move) const;
     bool gives_check(move_t move) const;
 
+    // Hashes of the position after a move or null move, without making it, so that table lookups can be prefetched
+    U64 key_after(move_t move) const;
+    U64 pawn_key_after(move_t move) const;
+
     bool is_repetition_draw(int search_ply) const;
+    int upcoming_repetition() const;
     bool is_material_draw() const;
 
     int see(move_t move) const;
+    bool see_ge(move_t move, int threshold) const;
+
+    // Static exchange evaluation, skipping the exchange if the attack map of the position shows that the opponent
+    // cannot recapture
+    int see(move_t move, const attack_map_t &attacks) const;
+    bool see_ge(move_t move, int threshold, const attack_map_t &attacks) const;
     U64 non_pawn_material(Team side) const;
 
     void mirror();
@@ -85,9 +151,20 @@ struct alignas(64) board_t {
     std::vector<game_record_t> record;
 
     /* Internal methods */
+    // Make and unmake a move of TEAM, or a null move, dispatched once on the side that moves
+    template<Team TEAM>
+    void move(move_t move);
+    template<Team TEAM>
+    void unmove(move_t move, sq_data_t captured);
+
     template<bool HASH>
     void switch_piece(Team side, Piece piece, uint8_t sq);
 
+    bool see_attacker(U64 attackers, Team side, bool prom_rank, uint8_t &from) const;
+    U64 see_xrays(uint8_t sq, U64 occupied) const;
+    bool see_undefended(move_t move, const attack_map_t &attacks) const;
+    int see_gain(move_t move) const;
+
     void print();
 };
 
@@ -0,0 +1,91 @@
+#ifndef TOPPLE_BOOK_H
+#define TOPPLE_BOOK_H
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "move.h"
+#include "board.h"
+
+namespace book {
+    /**
+     * A decoded Polyglot book entry. Entries are stored big-endian in 16 bytes, sorted by key.
+     */
+    struct entry_t {
+        U64 key;
+        uint16_t move; // to file, to row, from file, from row and promotion piece, 3 bits each
+        uint16_t weight;
+        uint32_t learn;
+    };
+
+    /**
+     * Compute the Polyglot key of a position. Polyglot keys use their own random numbers, so that books made by other
+     * programs can be used.
+     */
+    U64 polyglot_key(const board_t &board);
+
+    /**
+     * Convert a Polyglot move to a legal move in the given position, or EMPTY_MOVE if it is not legal.
+     */
+    move_t to_move(const board_t &board, uint16_t polyglot_move);
+
+    /**
+     * Polyglot move in coordinate notation, with castling written as the king capturing its rook
+     */
+    std::string move_str(uint16_t polyglot_move);
+
+    /**
+     * Read-only Polyglot opening book, memory-mapped where possible.
+     */
+    class book_t {
+    public:
+        /**
+         * Open a book
+         *
+         * @throws std::runtime_error if the file cannot be read
+         */
+        explicit book_t(const std::string &path);
+        ~book_t();
+        book_t(const book_t &) = delete;
+
+        [[nodiscard]] size_t size() const { return count; }
+        [[nodiscard]] entry_t at(size_t index) const;
+
+        /**
+         * Find all entries for a key, by binary search
+         */
+        [[nodiscard]] std::vector<entry_t> find(U64 key) const;
+
+        /**
+         * Pick a legal book move for the position, at random in proportion to the entry weights.
+         *
+         * @return EMPTY_MOVE if the position is not in the book
+         */
+        [[nodiscard]] move_t probe(const board_t &board) const;
+    private:
+        const unsigned char *data = nullptr;
+        size_t count = 0;
+
+        size_t mapped_size = 0;
+        std::vector<unsigned char> buffer; // Used if the file cannot be mapped
+    };
+
+    /**
+     * Convert and merge books.
+     *
+     * Usage: Topple book merge <out.bin> <in.bin>...
+     *        Topple book dump <in.bin>
+     *        Topple book convert <in.txt> <out.bin>
+     *
+     * Merging sums the weights of moves found in several books, scaling them down if necessary. Dumping writes one line
+     * per entry, as the key in hex, the move, the weight and the learn value, and converting reads that format back.
+     *
+     * @param argc number of arguments following the mode
+     * @param argv arguments following the mode
+     * @return process exit code
+     */
+    int tool(int argc, char *argv[]);
+}
+
+#endif //TOPPLE_BOOK_H
@@ -0,0 +1,490 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <future>
+#include <memory>
+
+#include "cluster.h"
+#include "board.h"
+#include "search.h"
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace cluster {
+    namespace {
+        // Messages are framed by a 4 byte length in network order and a 1 byte type
+        enum MessageType : uint8_t {
+            SEARCH = 1, // Search id, depth limit, node limit, then the position as "fen\nmoves\nsearchmoves"
+            STOP,
+            NEW_GAME,
+            ENTRIES, // Transposition table entries
+            RESULT // Search id, depth, score, then the PV
+        };
+
+        constexpr size_t HEADER_SIZE = 5;
+        constexpr int POLL_INTERVAL = 20; // ms
+
+        template<typename T>
+        void put(std::string &payload, T value) {
+            payload.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        T get(const std::string &payload, size_t offset) {
+            T value = {};
+            if (payload.size() >= offset + sizeof(T)) std::memcpy(&value, payload.data() + offset, sizeof(T));
+            return value;
+        }
+
+        bool send_message(int fd, uint8_t type, const std::string &payload) {
+            std::string frame;
+            put<uint32_t>(frame, htonl(uint32_t(payload.size())));
+            put<uint8_t>(frame, type);
+            frame += payload;
+
+            const char *data = frame.data();
+            size_t size = frame.size();
+            while (size > 0) {
+                ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+                if (sent <= 0) return false;
+                data += sent;
+                size -= sent;
+            }
+            return true;
+        }
+
+        // Append whatever is available to the buffer. Returns false once the connection is closed.
+        bool receive(int fd, std::string &buffer) {
+            char data[65536];
+            ssize_t received = recv(fd, data, sizeof(data), 0);
+            if (received <= 0) return false;
+            buffer.append(data, received);
+            return true;
+        }
+
+        bool next_message(std::string &buffer, uint8_t &type, std::string &payload) {
+            if (buffer.size() < HEADER_SIZE) return false;
+
+            uint32_t size = ntohl(get<uint32_t>(buffer, 0));
+            if (buffer.size() < HEADER_SIZE + size) return false;
+
+            type = uint8_t(buffer[4]);
+            payload = buffer.substr(HEADER_SIZE, size);
+            buffer.erase(0, HEADER_SIZE + size);
+            return true;
+        }
+
+        std::string encode_entries(const std::vector<tt::entry_t> &entries) {
+            return std::string(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(tt::entry_t));
+        }
+
+        // Peers only share entries of at least SHARE_DEPTH, so anything shallower did not come from a peer's search
+        void import_entries(tt::hash_t *tt, const std::string &payload) {
+            for (size_t offset = 0; offset + sizeof(tt::entry_t) <= payload.size(); offset += sizeof(tt::entry_t)) {
+                tt::entry_t entry = get<tt::entry_t>(payload, offset);
+                if (entry.depth() >= SHARE_DEPTH) tt->import(entry);
+            }
+        }
+
+        int connect_to(const std::string &address) {
+            size_t colon = address.rfind(':');
+            if (colon == std::string::npos) return -1;
+
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo *info;
+            if (getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(), &hints, &info)) {
+                return -1;
+            }
+
+            int fd = -1;
+            for (addrinfo *it = info; it; it = it->ai_next) {
+                fd = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+                if (fd < 0) continue;
+                if (connect(fd, it->ai_addr, it->ai_addrlen) == 0) break;
+                close(fd);
+                fd = -1;
+            }
+            freeaddrinfo(info);
+
+            if (fd >= 0) {
+                int flag = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+            }
+            return fd;
+        }
+
+        int listen_on(const std::string &host, int port) {
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_PASSIVE;
+
+            addrinfo *info;
+            if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &info)) {
+                return -1;
+            }
+
+            int fd = -1;
+            for (addrinfo *it = info; it; it = it->ai_next) {
+                fd = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+                if (fd < 0) continue;
+
+                int flag = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+                if (bind(fd, it->ai_addr, it->ai_addrlen) == 0 && listen(fd, 1) == 0) break;
+                close(fd);
+                fd = -1;
+            }
+            freeaddrinfo(info);
+            return fd;
+        }
+    }
+
+    front_t::front_t(const std::vector<std::string> &peers) {
+        for (const std::string &peer : peers) {
+            int fd = connect_to(peer);
+            if (fd >= 0) {
+                sockets.push_back(fd);
+                buffers.emplace_back();
+            } else {
+                std::cerr << "warn: could not connect to cluster peer " << peer << std::endl;
+            }
+        }
+
+        thread = std::thread(&front_t::run, this);
+    }
+
+    front_t::~front_t() {
+        terminated = true;
+        thread.join();
+
+        for (int fd : sockets) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    size_t front_t::connected() {
+        std::lock_guard<std::mutex> lock(send_mtx);
+        return std::count_if(sockets.begin(), sockets.end(), [](int fd) { return fd >= 0; });
+    }
+
+    void front_t::start(const std::string &fen, const std::vector<std::string> &moves, const search_limits_t &limits,
+                        tt::hash_t *tt) {
+        std::string payload;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            search_id++;
+            best = peer_result_t();
+            this->tt = tt;
+            tt->set_export_depth(SHARE_DEPTH);
+
+            put<uint32_t>(payload, search_id);
+        }
+        put<int32_t>(payload, limits.depth_limit);
+        put<uint64_t>(payload, limits.node_limit);
+
+        std::ostringstream position;
+        position << fen << "\n";
+        for (const std::string &move : moves) {
+            position << move << " ";
+        }
+        position << "\n";
+        for (move_t move : limits.search_moves) {
+            position << move << " ";
+        }
+        payload += position.str();
+
+        broadcast(SEARCH, payload);
+    }
+
+    peer_result_t front_t::stop() {
+        broadcast(STOP, "");
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (tt) tt->set_export_depth(0);
+        tt = nullptr;
+        return best;
+    }
+
+    void front_t::new_game() {
+        broadcast(NEW_GAME, "");
+    }
+
+    void front_t::broadcast(uint8_t type, const std::string &payload) {
+        std::lock_guard<std::mutex> lock(send_mtx);
+        for (int &fd : sockets) {
+            if (fd >= 0 && !send_message(fd, type, payload)) {
+                std::cerr << "warn: lost connection to a cluster peer" << std::endl;
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+    }
+
+    void front_t::run() {
+        std::vector<tt::entry_t> entries;
+        std::vector<pollfd> fds(sockets.size());
+
+        while (!terminated) {
+            for (size_t i = 0; i < sockets.size(); i++) {
+                fds[i] = {sockets[i], POLLIN, 0};
+            }
+            poll(fds.data(), fds.size(), POLL_INTERVAL);
+
+            for (size_t i = 0; i < sockets.size(); i++) {
+                if (sockets[i] < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+                if (!receive(sockets[i], buffers[i])) {
+                    std::lock_guard<std::mutex> lock(send_mtx);
+                    close(sockets[i]);
+                    sockets[i] = -1;
+                    continue;
+                }
+
+                uint8_t type;
+                std::string payload;
+                while (next_message(buffers[i], type, payload)) {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (!tt) continue; // Messages from a search which has been stopped
+
+                    if (type == ENTRIES) {
+                        import_entries(tt, payload);
+                    } else if (type == RESULT && get<uint32_t>(payload, 0) == search_id) {
+                        int depth = get<int32_t>(payload, 4);
+                        if (depth > best.depth) {
+                            best.depth = depth;
+                            best.score = get<int32_t>(payload, 8);
+                            best.pv = payload.substr(12);
+                        }
+                    }
+                }
+            }
+
+            // Share our own deep entries
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (tt) tt->drain_exports(entries);
+            }
+            if (!entries.empty()) {
+                broadcast(ENTRIES, encode_entries(entries));
+                entries.clear();
+            }
+        }
+    }
+
+    namespace {
+        void serve(int fd, const processed_params_t &params, int threads, size_t hash_mb) {
+            std::unique_ptr<tt::hash_t> table;
+            std::unique_ptr<search_t> search;
+            std::unique_ptr<board_t> board;
+            std::atomic_bool aborted = false;
+            std::future<void> future;
+            std::atomic<uint32_t> search_id{0};
+            std::mutex send_mtx;
+
+            auto create = [&]() {
+                search.reset();
+                table = std::make_unique<tt::hash_t>(hash_mb * MB);
+                table->set_export_depth(SHARE_DEPTH);
+                search = std::make_unique<search_t>(table.get(), params, threads);
+
+                // Report every completed iteration
+                search->set_info_callback([&](const search_info_t &info) {
+                    if (info.bound != tt::EXACT || info.pv.empty()) return;
+
+                    std::string payload;
+                    put<uint32_t>(payload, search_id);
+                    put<int32_t>(payload, info.depth);
+                    put<int32_t>(payload, info.score);
+
+                    std::ostringstream pv;
+                    for (move_t move : info.pv) pv << move << " ";
+                    payload += pv.str();
+
+                    std::lock_guard<std::mutex> lock(send_mtx);
+                    send_message(fd, RESULT, payload);
+                });
+            };
+
+            auto stop = [&]() {
+                if (future.valid()) {
+                    search->enable_timer();
+                    aborted = true;
+                    future.wait();
+                    future = std::future<void>();
+                }
+            };
+
+            create();
+
+            std::string buffer;
+            std::vector<tt::entry_t> entries;
+            bool connected = true;
+            while (connected) {
+                pollfd pfd = {fd, POLLIN, 0};
+                if (poll(&pfd, 1, POLL_INTERVAL) > 0) connected = receive(fd, buffer);
+
+                uint8_t type;
+                std::string payload;
+                while (next_message(buffer, type, payload)) {
+                    if (type == SEARCH) {
+                        stop();
+
+                        int depth = std::clamp(get<int32_t>(payload, 4), 1, MAX_PLY);
+                        uint64_t nodes = get<uint64_t>(payload, 8);
+
+                        std::istringstream iss(payload.size() > 16 ? payload.substr(16) : "");
+                        std::string fen, line, move_str;
+                        std::getline(iss, fen);
+                        try {
+                            board = std::make_unique<board_t>(fen);
+                        } catch (std::exception &e) {
+                            std::cerr << "warn: cluster search with invalid position: " << e.what() << std::endl;
+                            continue;
+                        }
+
+                        std::getline(iss, line);
+                        std::istringstream moves(line);
+                        while (moves >> move_str) {
+                            move_t move = board->parse_move(move_str);
+                            if (board->is_pseudo_legal(move) && board->is_legal(move)) board->move(move);
+                        }
+
+                        // Search the same moves as the front
+                        std::vector<move_t> search_moves;
+                        while (iss >> move_str) {
+                            move_t move = board->parse_move(move_str);
+                            if (board->is_pseudo_legal(move) && board->is_legal(move)) search_moves.push_back(move);
+                        }
+
+                        search_id = get<uint32_t>(payload, 0);
+                        table->age();
+                        aborted = false;
+                        search->enable_timer();
+                        future = std::async(std::launch::async, [&, depth, nodes, search_moves]() {
+                            search_limits_t limits(INT_MAX, depth, nodes, search_moves);
+                            search->think(*board, limits, aborted);
+                            search->reset_timer();
+                        });
+                    } else if (type == STOP) {
+                        stop();
+                    } else if (type == NEW_GAME) {
+                        stop();
+                        create();
+                    } else if (type == ENTRIES) {
+                        import_entries(table.get(), payload);
+                    }
+                }
+
+                table->drain_exports(entries);
+                if (!entries.empty()) {
+                    std::lock_guard<std::mutex> lock(send_mtx);
+                    connected &= send_message(fd, ENTRIES, encode_entries(entries));
+                    entries.clear();
+                }
+            }
+
+            stop();
+        }
+    }
+
+    int worker(int argc, char *argv[]) {
+        int port = 0;
+        std::string host = "127.0.0.1";
+        int threads = 1;
+        size_t hash_mb = 128;
+
+        const char *usage = "usage: Topple worker --port N [--bind address] [--threads N] [--hash MB]";
+        for (int i = 0; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+
+            try {
+                if (arg == "--port" && has_value) {
+                    port = std::stoi(argv[++i]);
+                } else if (arg == "--bind" && has_value) {
+                    host = argv[++i];
+                } else if (arg == "--threads" && has_value) {
+                    threads = std::max(1, std::stoi(argv[++i]));
+                } else if (arg == "--hash" && has_value) {
+                    hash_mb = std::max(1, std::stoi(argv[++i]));
+                } else {
+                    port = 0;
+                    break;
+                }
+            } catch (std::exception &) {
+                std::cerr << "error: invalid value " << argv[i] << " for " << arg << "\n" << usage << std::endl;
+                return 1;
+            }
+        }
+
+        if (port <= 0 || port > 65535) {
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+
+        // The protocol has no authentication, so only the local host can connect unless another address is given
+        int listen_fd = listen_on(host, port);
+        if (listen_fd < 0) {
+            std::cerr << "error: could not listen on " << host << " port " << port << std::endl;
+            return 1;
+        }
+
+        std::cout << "Topple " TOPPLE_VER " (c) Vincent Tang 2020, cluster worker on " << host << " port " << port
+                  << std::endl;
+
+        processed_params_t params = processed_params_t(eval_params_t());
+        while (true) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) continue;
+
+            int flag = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+            serve(fd, params, threads, hash_mb);
+            close(fd);
+        }
+    }
+}
+
+#else
+
+namespace cluster {
+    front_t::front_t(const std::vector<std::string> &peers) {
+        std::cerr << "warn: cluster search requires POSIX sockets" << std::endl;
+    }
+
+    front_t::~front_t() = default;
+
+    size_t front_t::connected() {
+        return 0;
+    }
+
+    void front_t::start(const std::string &fen, const std::vector<std::string> &moves, const search_limits_t &limits,
+                        tt::hash_t *tt) {}
+
+    peer_result_t front_t::stop() {
+        return peer_result_t();
+    }
+
+    void front_t::new_game() {}
+
+    int worker(int argc, char *argv[]) {
+        std::cerr << "error: cluster workers require POSIX sockets" << std::endl;
+        return 1;
+    }
+}
+
+#endif
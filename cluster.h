@@ -0,0 +1,95 @@
+#ifndef TOPPLE_CLUSTER_H
+#define TOPPLE_CLUSTER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "hash.h"
+
+struct search_limits_t;
+
+/**
+ * Experimental distributed Lazy SMP. Worker processes search the same position as the UCI front, and every process
+ * shares its deep transposition table entries with the others. Workers report the result of each completed iteration to
+ * the front, which plays the deepest result when its own search ends. Peers must run the same build, as entries are
+ * sent in their in-memory layout. There is no authentication, so workers listen on the loopback interface unless told
+ * otherwise, and imported entries are checked before they are stored.
+ */
+namespace cluster {
+    // Entries saved with at least this depth are shared
+    constexpr int SHARE_DEPTH = 8;
+
+    struct peer_result_t {
+        int depth = 0;
+        int score = 0;
+        std::string pv; // Coordinate notation, separated by spaces
+    };
+
+    /**
+     * Connections from the UCI front to its workers.
+     */
+    class front_t {
+    public:
+        /**
+         * Connect to the given workers
+         *
+         * @param peers addresses in the form host:port
+         */
+        explicit front_t(const std::vector<std::string> &peers);
+        ~front_t();
+        front_t(const front_t &) = delete;
+
+        size_t connected();
+
+        /**
+         * Start the workers searching the given position, and exchange entries with the given table until stopped.
+         * Workers keep to the depth and node limits and the search moves of the given limits, while the front stops
+         * them when its own time runs out.
+         */
+        void start(const std::string &fen, const std::vector<std::string> &moves, const search_limits_t &limits,
+                   tt::hash_t *tt);
+
+        /**
+         * Stop the workers, and stop exchanging entries.
+         *
+         * @return the deepest result reported by a worker since the search started
+         */
+        peer_result_t stop();
+
+        /**
+         * Clear the workers' tables
+         */
+        void new_game();
+    private:
+        void run();
+        void broadcast(uint8_t type, const std::string &payload);
+
+        std::vector<int> sockets;
+        std::vector<std::string> buffers;
+
+        std::mutex send_mtx; // Guards the sockets
+        std::mutex mtx; // Guards the search state
+        tt::hash_t *tt = nullptr;
+        uint32_t search_id = 0;
+        peer_result_t best;
+
+        std::atomic_bool terminated = false;
+        std::thread thread;
+    };
+
+    /**
+     * Run a worker process, which serves one front at a time.
+     *
+     * Usage: Topple worker --port N [--bind address] [--threads N] [--hash MB]
+     *
+     * @param argc number of arguments following the mode
+     * @param argv arguments following the mode
+     * @return process exit code
+     */
+    int worker(int argc, char *argv[]);
+}
+
+#endif //TOPPLE_CLUSTER_H
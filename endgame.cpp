@@ -2,6 +2,8 @@
 // Created by Vincent on 09/06/2018.
 //
 
+#include <vector>
+
 #include "endgame.h"
 
 constexpr int PREFER = 100;
@@ -32,8 +34,142 @@ constexpr int KBNK[64]{
 
 constexpr int TOGETHER[8]{0, 20, 16, 12, 8, 4, 2, 0};
 
+// KPK bitbase: one bit per position with WHITE holding the pawn on files A-D, set if WHITE wins
+constexpr size_t KPK_SIZE = 2 * 24 * 64 * 64;
+uint32_t kpk_bitbase[KPK_SIZE / 32];
+
+enum KpkResult : uint8_t {
+    KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4
+};
+
+inline size_t kpk_index(Team side, uint8_t w_king, uint8_t b_king, uint8_t pawn) {
+    return w_king | (b_king << 6u) | (side << 12u) | (file_index(pawn) << 13u) | ((6u - rank_index(pawn)) << 15u);
+}
+
+// Results which follow from the position alone: illegal positions, safe promotions, stalemates and captured pawns
+uint8_t kpk_initial(Team side, uint8_t w_king, uint8_t b_king, uint8_t pawn) {
+    if (distance(w_king, b_king) <= 1 || w_king == pawn || b_king == pawn
+        || (side == WHITE && (bb_normal_moves::pawn_caps[WHITE][pawn] & single_bit(b_king)))) {
+        return KPK_INVALID;
+    }
+
+    if (side == WHITE) {
+        uint8_t promotion = pawn + 8;
+        if (rank_index(pawn) == 6 && w_king != promotion
+            && (distance(b_king, promotion) > 1 || distance(w_king, promotion) == 1)) {
+            return KPK_WIN;
+        }
+    } else {
+        U64 escapes = bb_normal_moves::king_moves[b_king]
+                      & ~(bb_normal_moves::king_moves[w_king] | bb_normal_moves::pawn_caps[WHITE][pawn]);
+        if (!escapes || (escapes & single_bit(pawn))) {
+            return KPK_DRAW;
+        }
+    }
+
+    return KPK_UNKNOWN;
+}
+
+// Results which follow from the results of the successor positions
+uint8_t kpk_classify(const std::vector<uint8_t> &db, Team side, uint8_t w_king, uint8_t b_king, uint8_t pawn) {
+    uint8_t result = KPK_INVALID;
+
+    if (side == WHITE) {
+        U64 bb = bb_normal_moves::king_moves[w_king];
+        while (bb) {
+            result |= db[kpk_index(BLACK, pop_bit(bb), b_king, pawn)];
+        }
+
+        if (rank_index(pawn) < 6) {
+            result |= db[kpk_index(BLACK, w_king, b_king, pawn + 8)];
+        }
+
+        if (rank_index(pawn) == 1 && pawn + 8 != w_king && pawn + 8 != b_king) {
+            result |= db[kpk_index(BLACK, w_king, b_king, pawn + 16)];
+        }
+
+        return (result & KPK_WIN) ? KPK_WIN : (result & KPK_UNKNOWN) ? KPK_UNKNOWN : KPK_DRAW;
+    } else {
+        U64 bb = bb_normal_moves::king_moves[b_king];
+        while (bb) {
+            result |= db[kpk_index(WHITE, w_king, pop_bit(bb), pawn)];
+        }
+
+        return (result & KPK_DRAW) ? KPK_DRAW : (result & KPK_UNKNOWN) ? KPK_UNKNOWN : KPK_WIN;
+    }
+}
+
+void kpk_init() {
+    std::vector<uint8_t> db(KPK_SIZE);
+
+    auto decode = [](size_t idx, Team &side, uint8_t &w_king, uint8_t &b_king, uint8_t &pawn) {
+        w_king = idx & 63u;
+        b_king = (idx >> 6u) & 63u;
+        side = Team((idx >> 12u) & 1u);
+        pawn = square_index((idx >> 13u) & 3u, 6 - (idx >> 15u));
+    };
+
+    Team side;
+    uint8_t w_king, b_king, pawn;
+    for (size_t idx = 0; idx < KPK_SIZE; idx++) {
+        decode(idx, side, w_king, b_king, pawn);
+        db[idx] = kpk_initial(side, w_king, b_king, pawn);
+    }
+
+    // Retrograde analysis: iterate until no unknown position can be resolved. The rest are draws.
+    bool repeat = true;
+    while (repeat) {
+        repeat = false;
+        for (size_t idx = 0; idx < KPK_SIZE; idx++) {
+            if (db[idx] == KPK_UNKNOWN) {
+                decode(idx, side, w_king, b_king, pawn);
+                db[idx] = kpk_classify(db, side, w_king, b_king, pawn);
+                repeat |= db[idx] != KPK_UNKNOWN;
+            }
+        }
+    }
+
+    std::fill(std::begin(kpk_bitbase), std::end(kpk_bitbase), 0);
+    for (size_t idx = 0; idx < KPK_SIZE; idx++) {
+        if (db[idx] == KPK_WIN) {
+            kpk_bitbase[idx / 32] |= 1u << (idx % 32);
+        }
+    }
+}
+
 void eg_init() {
-    // Reserved
+    kpk_init();
+}
+
+bool eg_kpk_win(Team strong, uint8_t strong_king, uint8_t pawn, uint8_t weak_king, Team side) {
+    // Normalise to WHITE holding the pawn on files A-D
+    if (strong == BLACK) {
+        strong_king = MIRROR_TABLE[strong_king];
+        weak_king = MIRROR_TABLE[weak_king];
+        pawn = MIRROR_TABLE[pawn];
+    }
+
+    if (file_index(pawn) >= 4) {
+        strong_king ^= 7u;
+        weak_king ^= 7u;
+        pawn ^= 7u;
+    }
+
+    size_t idx = kpk_index(side == strong ? WHITE : BLACK, strong_king, weak_king, pawn);
+    return (kpk_bitbase[idx / 32] >> (idx % 32)) & 1u;
+}
+
+bool eg_kpk_draw(const board_t &board) {
+    if (pop_count(board.bb_all) != 3) return false;
+
+    for (Team team : {WHITE, BLACK}) {
+        if (board.bb_pieces[team][PAWN]) {
+            return !eg_kpk_win(team, bit_scan(board.bb_pieces[team][KING]), bit_scan(board.bb_pieces[team][PAWN]),
+                               bit_scan(board.bb_pieces[!team][KING]), board.record.back().next_move);
+        }
+    }
+
+    return false;
 }
 
 int eval_material(int mat[2][6]) {
@@ -90,44 +226,116 @@ int eval_kbnk(const board_t &board, Team team) {
     return eval;
 }
 
-eg_eval_t eval_eg(const board_t &board) {
+int eval_draw(const board_t &board) {
+    return 0;
+}
+
+template<Team TEAM>
+int eval_kbnk_win(const board_t &board) {
+    int eval = VALUE[BISHOP] + VALUE[KNIGHT] + KNOWN_WIN + PREFER + eval_kbnk(board, TEAM);
+    return TEAM == WHITE ? eval : -eval;
+}
+
+template<Team TEAM>
+int eval_kpk(const board_t &board) {
+    uint8_t pawn = bit_scan(board.bb_pieces[TEAM][PAWN]);
+    if (!eg_kpk_win(TEAM, bit_scan(board.bb_pieces[TEAM][KING]), pawn, bit_scan(board.bb_pieces[!TEAM][KING]),
+                    board.record.back().next_move)) {
+        return 0;
+    }
+
+    // Push the pawn
+    int eval = VALUE[PAWN] + KNOWN_WIN + 10 * rel_rank(TEAM, rank_index(pawn));
+    return TEAM == WHITE ? eval : -eval;
+}
+
+template<Team TEAM>
+int eval_mating_win(const board_t &board) {
+    int mat[2][6] = {};
+    for (uint8_t piece = PAWN; piece <= KING; piece++) {
+        mat[TEAM][piece] = pop_count(board.bb_pieces[TEAM][piece]);
+    }
+
+    int eval = eval_material(mat) * (TEAM == WHITE ? 1 : -1) + KNOWN_WIN + eval_universal(board, TEAM);
+    return TEAM == WHITE ? eval : -eval;
+}
+
+template int eval_kbnk_win<WHITE>(const board_t &board);
+template int eval_kbnk_win<BLACK>(const board_t &board);
+template int eval_kpk<WHITE>(const board_t &board);
+template int eval_kpk<BLACK>(const board_t &board);
+template int eval_mating_win<WHITE>(const board_t &board);
+template int eval_mating_win<BLACK>(const board_t &board);
+
+eg_eval_fn eg_evaluator(material_data_t material) {
     // Count material
     int mat[2][6] = {};
     int total_mat[2] = {};
     for (uint8_t team = WHITE; team <= BLACK; team++) {
         for (uint8_t piece = PAWN; piece <= KING; piece++) {
-            int count = pop_count(board.bb_pieces[team][piece]);
-            mat[team][piece] = count;
-            total_mat[team] += count;
+            mat[team][piece] = material.info.count(Team(team), Piece(piece));
+            total_mat[team] += mat[team][piece];
         }
     }
 
     // Process material
-    if ((total_mat[WHITE] == 1 && total_mat[BLACK] == 1)) {
-        // KvK
-        return {true, 0};
-    } else if (mat[WHITE][PAWN] == 0 && mat[BLACK][PAWN] == 0) {
-        // No pawns
-        if (mat[WHITE][ROOK] == 0 && mat[WHITE][QUEEN] == 0 && mat[BLACK][ROOK] == 0 && mat[WHITE][ROOK] == 0) {
-            // No major pieces
-            if ((mat[WHITE][BISHOP] == 0 && mat[BLACK][BISHOP] == 0 && total_mat[WHITE] < 3 && total_mat[BLACK] < 3)
-                || (abs(total_mat[WHITE] - total_mat[BLACK]) <= 1)) {
-                return {true, 0};
-            } else {
-                // KBNvK
-                if (mat[WHITE][BISHOP] == 1 && mat[WHITE][KNIGHT] == 1 && total_mat[BLACK] == 1) {
-                    return {true, eval_material(mat) + eval_kbnk(board, WHITE) + PREFER};
-                } else if (mat[BLACK][BISHOP] == 1 && mat[BLACK][KNIGHT] == 1 && total_mat[WHITE] == 1) {
-                    return {true, eval_material(mat) - eval_kbnk(board, BLACK) - PREFER};
-                }
-            }
+    if (mat[WHITE][PAWN] || mat[BLACK][PAWN]) {
+        // KPvK
+        if (mat[WHITE][PAWN] == 1 && total_mat[WHITE] == 2 && total_mat[BLACK] == 1) {
+            return eval_kpk<WHITE>;
+        } else if (mat[BLACK][PAWN] == 1 && total_mat[BLACK] == 2 && total_mat[WHITE] == 1) {
+            return eval_kpk<BLACK>;
         }
 
-        // Fall back on universal endgame evaluation
-        return {true, eval_material(mat) + eval_universal(board, WHITE) - eval_universal(board, BLACK)};
-    } else {
         // TODO: Pawn endgames
+        return nullptr;
+    } else if (total_mat[WHITE] == 1 && total_mat[BLACK] == 1) {
+        // KvK
+        return eval_draw;
+    }
+
+    // No pawns
+    if (mat[WHITE][ROOK] == 0 && mat[WHITE][QUEEN] == 0 && mat[BLACK][ROOK] == 0 && mat[BLACK][QUEEN] == 0) {
+        // No major pieces
+        if ((mat[WHITE][BISHOP] == 0 && mat[BLACK][BISHOP] == 0 && total_mat[WHITE] < 3 && total_mat[BLACK] < 3)
+            || (abs(total_mat[WHITE] - total_mat[BLACK]) <= 1)) {
+            return eval_draw;
+        }
+
+        // KBNvK
+        if (mat[WHITE][BISHOP] == 1 && mat[WHITE][KNIGHT] == 1 && total_mat[WHITE] == 3 && total_mat[BLACK] == 1) {
+            return eval_kbnk_win<WHITE>;
+        } else if (mat[BLACK][BISHOP] == 1 && mat[BLACK][KNIGHT] == 1 && total_mat[BLACK] == 3 && total_mat[WHITE] == 1) {
+            return eval_kbnk_win<BLACK>;
+        }
+    }
+
+    // Mating material against a bare king
+    for (Team team : {WHITE, BLACK}) {
+        if (total_mat[!team] == 1 && (mat[team][QUEEN] || mat[team][ROOK] || mat[team][BISHOP] >= 2
+                                      || (mat[team][BISHOP] && mat[team][KNIGHT]))) {
+            return team == WHITE ? eval_mating_win<WHITE> : eval_mating_win<BLACK>;
+        }
+    }
+
+    return nullptr;
+}
+
+int eg_scale(material_data_t material, Team team) {
+    int npm[2] = {};
+    for (uint8_t side = WHITE; side <= BLACK; side++) {
+        for (uint8_t piece = KNIGHT; piece < KING; piece++) {
+            npm[side] += material.info.count(Team(side), Piece(piece)) * VALUE[piece];
+        }
+    }
+
+    // Without pawns, at most a minor piece ahead is hard or impossible to win
+    unsigned pawns = material.info.count(team, PAWN);
+    if (pawns == 0 && npm[team] - npm[!team] <= VALUE[BISHOP]) {
+        return npm[team] < VALUE[ROOK] ? 0 : npm[!team] <= VALUE[BISHOP] ? 4 : 14;
+    } else if (pawns == 1 && npm[team] - npm[!team] <= VALUE[BISHOP]) {
+        return 48;
     }
 
-    return {false, 0};
+    return SCALE_NORMAL;
 }
@@ -9,26 +9,61 @@
 
 #include "board.h"
 
-struct eg_eval_t {
-    eg_eval_t(bool valid, int eval) : valid(valid), eval(eval) {};
+/**
+ * Specialised evaluation of a position, relative to WHITE
+ */
+typedef int (*eg_eval_fn)(const board_t &board);
 
-    bool valid;
-    int eval;
-};
+// Scale factors for the endgame score, out of SCALE_NORMAL
+constexpr int SCALE_NORMAL = 64;
 
 /**
- * Initialise evaluation tables. Must be called before {@link eval}
+ * Initialise evaluation tables, and generate the KPK bitbase. Must be called before {@link eval}
  */
 void eg_init();
 
 /**
- * Return an evaluation of an endgame in {@code board}, relative to the side to move.
+ * Probe the KPK bitbase generated by {@link eg_init}
  *
- * {@link eg_init> must have been called first
+ * @param strong side with the pawn
+ * @param strong_king square of the king of the side with the pawn
+ * @param pawn square of the pawn
+ * @param weak_king square of the lone king
+ * @param side side to move
+ * @return true if the side with the pawn wins
+ */
+bool eg_kpk_win(Team strong, uint8_t strong_king, uint8_t pawn, uint8_t weak_king, Team side);
+
+/**
+ * Determine whether {@code board} is a king and pawn against king endgame which is drawn
  *
  * @param board
- * @return evaluation relative to WHITE
+ * @return true if the position is KPK and drawn
+ */
+bool eg_kpk_draw(const board_t &board);
+
+/**
+ * Find the specialised evaluation for a material balance. Known draws and known wins are evaluated by these, and
+ * need no other evaluation.
+ *
+ * @param material material balance
+ * @return evaluation function, or nullptr if the normal evaluation should be used
+ */
+eg_eval_fn eg_evaluator(material_data_t material);
+
+// Specialised evaluations returned by eg_evaluator, with the side which is winning as TEAM
+int eval_draw(const board_t &board);
+template<Team TEAM> int eval_kbnk_win(const board_t &board);
+template<Team TEAM> int eval_kpk(const board_t &board);
+template<Team TEAM> int eval_mating_win(const board_t &board);
+
+/**
+ * Scale factor for the endgame score when {@code team} is ahead, for material balances which are hard to win.
+ *
+ * @param material material balance
+ * @param team side which is ahead
+ * @return scale factor out of SCALE_NORMAL
  */
-eg_eval_t eval_eg(const board_t &board);
+int eg_scale(material_data_t material, Team team);
 
 #endif //TOPPLE_ENDGAME_H
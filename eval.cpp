@@ -6,7 +6,6 @@
 #include "endgame.h"
 #include <algorithm>
 #include <cstring>
-#include <cmath>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Utility tables
@@ -37,78 +36,28 @@ void evaluator_t::eval_init() {
     }
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-/// Preprocessing evaluation parameters
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-processed_params_t::processed_params_t(const eval_params_t &params)
-        : eval_params_t(params) {
-    // Four-way mirrored tables
-    constexpr uint8_t square_mapping[16][4] = {{A4, A5, H4, H5},
-                                               {B4, B5, G4, G5},
-                                               {C4, C5, F4, F5},
-                                               {D4, D5, E4, E5},
-                                               {A3, A6, H3, H6},
-                                               {B3, B6, G3, G6},
-                                               {C3, C6, F3, F6},
-                                               {D3, D6, E3, E6},
-                                               {A2, A7, H2, H7},
-                                               {B2, B7, G2, G7},
-                                               {C2, C7, F2, F7},
-                                               {D2, D7, E2, E7},
-                                               {A1, A8, H1, H8},
-                                               {B1, B8, G1, G8},
-                                               {C1, C8, F1, F8},
-                                               {D1, D8, E1, E8}};
-    for (int i = 0; i < 16; i++) {
-        for (int j = 0; j < 4; j++) {
-            pst[WHITE][KNIGHT][square_mapping[i][j]] = params.n_pst[i];
-            pst[WHITE][BISHOP][square_mapping[i][j]] = params.b_pst[i];
-            pst[WHITE][ROOK][square_mapping[i][j]] = params.r_pst[i];
-            pst[WHITE][QUEEN][square_mapping[i][j]] = params.q_pst[i];
-            pst[WHITE][KING][square_mapping[i][j]] = params.k_pst[i];
-        }
-    }
-
-    // Vertically mirrored tables
-    for (uint8_t sq = 0; sq < 64; sq++) {
-        int param_index = 32 - (4 - (file_index(sq) % 4) + rank_index(sq) * 4);
-
-        if (sq >= 8 && sq < 56) {
-            pst[WHITE][PAWN][sq] = params.p_pst[param_index - 4];
-        }
-    }
-
-    // Mirror PST for black
-    for (int piece = 0; piece < 6; piece++) {
-        for (int square = 0; square < 64; square++) {
-            pst[BLACK][piece][MIRROR_TABLE[square]] = pst[WHITE][piece][square];
-        }
-    }
-
-    // Set up king safety evaluation table.
-    for(int i = 0; i < 128; i++) {
-        // Translated + scaled sigmoid function
-        for (int j = 0; j < 4; j++) {
-            kat_table[i][j] = (int) ((double) params.kat_table_max[j] /
-                            (1 + exp((params.kat_table_translate - i) * double(params.kat_table_scale) / 1024.0)));
-        }
-    }
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Main evaluation functions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-evaluator_t::evaluator_t(const processed_params_t &params, size_t pawn_hash_size) : params(params) {
+evaluator_t::evaluator_t(const processed_params_t &params, size_t pawn_hash_size)
+#ifdef TOPPLE_RUNTIME_PARAMS
+        : params(params)
+#endif
+{
     // Set up pawn hash table
     pawn_hash_size /= sizeof(pawns::structure_t);
     this->pawn_hash_entries = tt::lower_power_of_2(pawn_hash_size) - 1;
     pawn_hash_table = new pawns::structure_t[pawn_hash_entries + 1]();
+
+    material_table = new material_entry_t[MATERIAL_TABLE_SIZE]();
+    king_hash_table = new pawns::king_shelter_t[KING_HASH_SIZE]();
 }
 
 evaluator_t::~evaluator_t() {
     delete[] pawn_hash_table;
+    delete[] material_table;
+    delete[] king_hash_table;
 }
 
 void evaluator_t::prefetch(U64 pawn_hash) {
@@ -122,7 +71,28 @@ void evaluator_t::prefetch(U64 pawn_hash) {
 #endif
 }
 
+void evaluator_t::set_network(const nnue::network_t *network) {
+    this->network = network;
+    accumulators.clear();
+}
+
 int evaluator_t::evaluate(const board_t &board) {
+    attack_map_t attacks;
+    return evaluate(board, attacks);
+}
+
+int evaluator_t::evaluate(const board_t &board, attack_map_t &attacks) {
+    const material_entry_t &material = probe_material(board.record.back().material);
+    if (material.evaluator) {
+        int eval = material.evaluator(board);
+        return board.record.back().next_move ? -eval : eval;
+    }
+
+    if (network) {
+        return network->evaluate(board, accumulators);
+    }
+
+    attacks.update(board);
     eval_data_t data = {};
 
     // Initialise king danger evaluation
@@ -132,31 +102,52 @@ int evaluator_t::evaluate(const board_t &board) {
     data.king_circle[BLACK] = BB_KING_CIRCLE[data.king_pos[BLACK]];
     data.king_danger[WHITE] = params.kat_zero;
     data.king_danger[BLACK] = params.kat_zero;
-    data.update_attacks(WHITE, KING, find_moves<KING>(WHITE, data.king_pos[WHITE], board.bb_all));
-    data.update_attacks(BLACK, KING, find_moves<KING>(BLACK, data.king_pos[BLACK], board.bb_all));
+    data.update_attacks(WHITE, KING, attacks.squares[data.king_pos[WHITE]]);
+    data.update_attacks(BLACK, KING, attacks.squares[data.king_pos[BLACK]]);
 
     // Score accumulator
-    v4si_t score = {0, 0, 0, 0};
+    v4hi_t score = {0, 0, 0, 0};
 
     // Main evaluation functions
-    float me_phase = game_phase(board);
-    float co_phase;
+    int co_phase;
     score += eval_pawns(board, data, co_phase);
-    score += eval_pieces(board, data);
+    score += eval_pieces(board, attacks, data);
     score += eval_threats(board, data);
     score += eval_positional(board, data);
 
+    int total = taper(score, co_phase, material.phase, material.scale);
+    return board.record.back().next_move ? -total : total;
+}
+
+int evaluator_t::taper(v4hi_t score, int co_phase, int me_phase, const uint8_t scale[2]) {
     // Interpolate between scores
-    float mg = co_phase * score[0] + (1 - co_phase) * score[1];
-    float eg = co_phase * score[2] + (1 - co_phase) * score[3];
-    auto total = int(me_phase * mg + (1 - me_phase) * eg);
+    int mg = (co_phase * score[0] + (TAPER_SCALE - co_phase) * score[1]) / TAPER_SCALE;
+    int eg = (co_phase * score[2] + (TAPER_SCALE - co_phase) * score[3]) / TAPER_SCALE;
+    eg = eg * scale[eg < 0 ? BLACK : WHITE] / SCALE_NORMAL;
+    return (me_phase * mg + (TAPER_SCALE - me_phase) * eg) / TAPER_SCALE;
+}
 
-    return board.record.back().next_move ? -total : total;
+const evaluator_t::material_entry_t &evaluator_t::probe_material(material_data_t material) {
+    material_entry_t &entry = material_table[(material.hash * 0x9E3779B97F4A7C15ULL) >> 51u];
+    stats.material_probes++;
+    if (entry.key == material.hash) {
+        stats.material_hits++;
+    } else {
+        entry.key = material.hash;
+        entry.phase = game_phase(material);
+        entry.scale[WHITE] = eg_scale(material, WHITE);
+        entry.scale[BLACK] = eg_scale(material, BLACK);
+        entry.evaluator = eg_evaluator(material);
+    }
+
+    return entry;
 }
 
 float evaluator_t::game_phase(const board_t &board) const {
-    material_data_t material = board.record.back().material;
+    return float(game_phase(board.record.back().material)) / TAPER_SCALE;
+}
 
+int evaluator_t::game_phase(material_data_t material) const {
     const int mat_w = params.mat_exch_knight * (material.info.w_knights)
                       + params.mat_exch_bishop * (material.info.w_bishops)
                       + params.mat_exch_rook * (material.info.w_rooks)
@@ -173,68 +164,83 @@ float evaluator_t::game_phase(const board_t &board) const {
 
     // Calculate tapering (game phase)
     // Close to 1 at the start, close to 0 at the end
-    return std::min((float(mat_total) / float(mat_max)), 1.0F);
+    return std::min(mat_total * TAPER_SCALE / mat_max, TAPER_SCALE);
 }
 
-v4si_t evaluator_t::eval_pieces(const board_t &board, eval_data_t &data) {
-    v4si_t score = {0, 0, 0, 0};
-    U64 pieces;
+v4hi_t evaluator_t::eval_pieces(const board_t &board, const attack_map_t &attack_map, eval_data_t &data) {
+    v4hi_t score = {0, 0, 0, 0};
     for (int type = KNIGHT; type < KING; type++) {
         U64 cached_double_attack_mask[2] = {~data.double_attacks[WHITE] | data.double_attacks[BLACK],
                                             ~data.double_attacks[BLACK] | data.double_attacks[WHITE]};
 
-        pieces = board.bb_pieces[WHITE][type];
-        while (pieces) {
-            uint8_t sq = pop_bit(pieces);
-            score += params.pst[WHITE][type][sq];
-
-            U64 attacks = find_moves(Piece(type), WHITE, sq, board.bb_all);
-            data.king_danger[WHITE] -= pop_count(attacks & data.king_circle[WHITE]) * params.kat_defence_weight[type];
-            data.king_danger[BLACK] += pop_count(attacks & data.king_circle[BLACK]) * params.kat_attack_weight[type];
-            data.update_attacks(WHITE, Piece(type), attacks);
-            int mobility = pop_count(attacks & ~data.attacks[BLACK][PAWN] & ~board.bb_side[WHITE] & cached_double_attack_mask[BLACK]);
-            score += mobility * params.pos_mob[type - 1];
-        }
-
-        pieces = board.bb_pieces[BLACK][type];
+        score += eval_pieces<WHITE>(board, Piece(type), attack_map, cached_double_attack_mask[BLACK], data);
+        score -= eval_pieces<BLACK>(board, Piece(type), attack_map, cached_double_attack_mask[WHITE], data);
+    }
 
-        while (pieces) {
-            uint8_t sq = pop_bit(pieces);
-            score -= params.pst[BLACK][type][sq];
+    return score;
+}
 
-            U64 attacks = find_moves(Piece(type), WHITE, sq, board.bb_all);
-            data.king_danger[BLACK] -= pop_count(attacks & data.king_circle[BLACK]) * params.kat_defence_weight[type];
-            data.king_danger[WHITE] += pop_count(attacks & data.king_circle[WHITE]) * params.kat_attack_weight[type];
-            data.update_attacks(BLACK, Piece(type), attacks);
-            int mobility = pop_count(attacks & ~data.attacks[WHITE][PAWN] & ~board.bb_side[BLACK] & cached_double_attack_mask[WHITE]);
-            score -= mobility * params.pos_mob[type - 1];
-        }
+template<Team TEAM>
+v4hi_t evaluator_t::eval_pieces(const board_t &board, Piece type, const attack_map_t &attack_map,
+                                U64 double_attack_mask, eval_data_t &data) {
+    constexpr Team X_TEAM = Team(!TEAM);
+
+    v4hi_t score = {0, 0, 0, 0};
+    U64 pieces = board.bb_pieces[TEAM][type];
+    while (pieces) {
+        uint8_t sq = pop_bit(pieces);
+        score += params.pst[TEAM][type][sq];
+
+        U64 attacks = attack_map.squares[sq];
+        data.king_danger[TEAM] -= pop_count(attacks & data.king_circle[TEAM]) * params.kat_defence_weight[type];
+        data.king_danger[X_TEAM] += pop_count(attacks & data.king_circle[X_TEAM]) * params.kat_attack_weight[type];
+        data.update_attacks(TEAM, type, attacks);
+        int mobility = pop_count(attacks & ~data.attacks[X_TEAM][PAWN] & ~board.bb_side[TEAM] & double_attack_mask);
+        score += int16_t(mobility) * params.pos_mob[type - 1];
     }
 
     return score;
 }
 
-v4si_t evaluator_t::eval_pawns(const board_t &board, eval_data_t &data, float &taper) {
-    U64 pawn_hash = board.record.back().kp_hash;
-    size_t index = (pawn_hash & pawn_hash_entries);
-    pawns::structure_t *entry = pawn_hash_table + index;
-    if(entry->get_hash() != pawn_hash) {
-        *entry = pawns::structure_t(params, pawn_hash,
-                                    board.bb_pieces[WHITE][PAWN], board.bb_pieces[BLACK][PAWN],
-                                    board.bb_pieces[WHITE][KING], board.bb_pieces[BLACK][KING]);
+v4hi_t evaluator_t::eval_pawns(const board_t &board, eval_data_t &data, int &taper) {
+    U64 w_pawns = board.bb_pieces[WHITE][PAWN];
+    U64 b_pawns = board.bb_pieces[BLACK][PAWN];
+
+    // Pawn structure
+    U64 pawn_hash = board.record.back().pawn_hash;
+    pawns::structure_t *entry = pawn_hash_table + (pawn_hash & pawn_hash_entries);
+    stats.pawn_probes++;
+    if (entry->get_hash() == pawn_hash) {
+        stats.pawn_hits++;
+    } else {
+        *entry = pawns::structure_t(params, pawn_hash, w_pawns, b_pawns);
     }
 
-    v4si_t score = {entry->get_eval_mg(), entry->get_eval_mg(), entry->get_eval_eg(), entry->get_eval_eg()};
+    v4hi_t score = {entry->get_eval_mg(), entry->get_eval_mg(), entry->get_eval_eg(), entry->get_eval_eg()};
     taper = entry->get_taper();
 
-    U64 w_pawns = board.bb_pieces[WHITE][PAWN];
-    U64 b_pawns = board.bb_pieces[BLACK][PAWN];
+    // King placement relative to the pawns
+    const pawns::king_shelter_t *shelter[2];
+    for (Team team : {WHITE, BLACK}) {
+        auto king_sq = uint8_t(data.king_pos[team]);
+        U64 key = pawn_hash ^ zobrist::squares[king_sq][team][KING];
+        pawns::king_shelter_t *king_entry = king_hash_table + (key & (KING_HASH_SIZE - 1));
+        stats.king_probes++;
+        if (king_entry->get_hash() == key) {
+            stats.king_hits++;
+        } else {
+            *king_entry = pawns::king_shelter_t(params, key, team, king_sq, data.king_circle[team],
+                                                BB_PAWN_SHIELD[king_sq], board.bb_pieces[team][PAWN],
+                                                board.bb_pieces[!team][PAWN], *entry);
+        }
+        shelter[team] = king_entry;
+    }
 
-    U64 open_files = pawns::open_files(w_pawns, b_pawns);
-    U64 half_open_files[2] = {
-            pawns::half_or_open_files(w_pawns) ^ open_files,
-            pawns::half_or_open_files(b_pawns) ^ open_files
-    };
+    score += shelter[WHITE]->get_score();
+    score -= shelter[BLACK]->get_score();
+
+    U64 open_files = entry->get_open_files();
+    U64 half_open_files[2] = {entry->get_half_open_files(WHITE), entry->get_half_open_files(BLACK)};
 
     // Blocked pawns
     U64 stop_squares[2] = {pawns::stop_squares<WHITE>(w_pawns), pawns::stop_squares<BLACK>(b_pawns)};
@@ -260,10 +266,10 @@ v4si_t evaluator_t::eval_pawns(const board_t &board, eval_data_t &data, float &t
     };
 
     // Outposts
-    U64 defended[2] = {pawns::attacks<WHITE>(w_pawns), pawns::attacks<BLACK>(b_pawns)};
+    U64 defended[2] = {entry->get_attacks(WHITE), entry->get_attacks(BLACK)};
     U64 outpost_squares[2] = {pawns::outpost[WHITE] & defended[WHITE] & ~defended[BLACK],
                               pawns::outpost[BLACK] & defended[BLACK] & ~defended[WHITE]};
-    U64 holes_bb[2] = {pawns::holes<WHITE>(w_pawns), pawns::holes<BLACK>(b_pawns)};
+    U64 holes_bb[2] = {entry->get_holes(WHITE), entry->get_holes(BLACK)};
 
     int outpost_count[2][2] = {
             {pop_count(outpost_squares[WHITE] & board.bb_pieces[WHITE][KNIGHT]),
@@ -285,13 +291,9 @@ v4si_t evaluator_t::eval_pawns(const board_t &board, eval_data_t &data, float &t
     };
 
     // Rooks
-    U64 passed[2] = {
-            pawns::passed<WHITE>(board.bb_pieces[WHITE][PAWN], board.bb_pieces[BLACK][PAWN]),
-            pawns::passed<BLACK>(board.bb_pieces[BLACK][PAWN], board.bb_pieces[WHITE][PAWN])
-    };
     U64 passed_rear[2] = {
-            bb_shifts::shift<D_S>(bb_shifts::fill_occluded<D_S>(passed[WHITE], ~board.bb_all)),
-            bb_shifts::shift<D_N>(bb_shifts::fill_occluded<D_N>(passed[BLACK], ~board.bb_all)),
+            bb_shifts::shift<D_S>(bb_shifts::fill_occluded<D_S>(entry->get_passed(WHITE), ~board.bb_all)),
+            bb_shifts::shift<D_N>(bb_shifts::fill_occluded<D_N>(entry->get_passed(BLACK), ~board.bb_all)),
     };
     int rook_behind[2][2] = {
             {pop_count(board.bb_pieces[WHITE][ROOK] & passed_rear[WHITE]),
@@ -300,26 +302,22 @@ v4si_t evaluator_t::eval_pawns(const board_t &board, eval_data_t &data, float &t
                     pop_count(board.bb_pieces[BLACK][ROOK] & passed_rear[WHITE])},
     };
 
-    // King shield
-    int pawn_shield_w = std::min(3, pop_count(BB_PAWN_SHIELD[data.king_pos[WHITE]] & board.bb_pieces[WHITE][PAWN]));
-    int pawn_shield_b = std::min(3, pop_count(BB_PAWN_SHIELD[data.king_pos[BLACK]] & board.bb_pieces[BLACK][PAWN]));
+    score += int16_t(blocked_count[WHITE][0] - blocked_count[BLACK][0]) * params.blocked[0];
+    score += int16_t(blocked_count[WHITE][1] - blocked_count[BLACK][1]) * params.blocked[1];
 
-    score += (blocked_count[WHITE][0] - blocked_count[BLACK][0]) * params.blocked[0];
-    score += (blocked_count[WHITE][1] - blocked_count[BLACK][1]) * params.blocked[1];
+    score += int16_t(open_file_count[WHITE] - open_file_count[BLACK]) * params.pos_r_open_file;
+    score += int16_t(own_half_open_file_count[WHITE] - own_half_open_file_count[BLACK]) * params.pos_r_own_half_open_file;
+    score += int16_t(other_half_open_file_count[WHITE] - other_half_open_file_count[BLACK]) * params.pos_r_other_half_open_file;
 
-    score += (open_file_count[WHITE] - open_file_count[BLACK]) * params.pos_r_open_file;
-    score += (own_half_open_file_count[WHITE] - own_half_open_file_count[BLACK]) * params.pos_r_own_half_open_file;
-    score += (other_half_open_file_count[WHITE] - other_half_open_file_count[BLACK]) * params.pos_r_other_half_open_file;
+    score += int16_t(outpost_count[WHITE][0] - outpost_count[BLACK][0]) * params.outpost[0];
+    score += int16_t(outpost_count[WHITE][1] - outpost_count[BLACK][1]) * params.outpost[1];
+    score += int16_t(outpost_hole_count[WHITE][0] - outpost_hole_count[BLACK][0]) * params.outpost_hole[0];
+    score += int16_t(outpost_hole_count[WHITE][1] - outpost_hole_count[BLACK][1]) * params.outpost_hole[1];
+    score += int16_t(outpost_half_count[WHITE][0] - outpost_half_count[BLACK][0]) * params.outpost_half[0];
+    score += int16_t(outpost_half_count[WHITE][1] - outpost_half_count[BLACK][1]) * params.outpost_half[1];
 
-    score += (outpost_count[WHITE][0] - outpost_count[BLACK][0]) * params.outpost[0];
-    score += (outpost_count[WHITE][1] - outpost_count[BLACK][1]) * params.outpost[1];
-    score += (outpost_hole_count[WHITE][0] - outpost_hole_count[BLACK][0]) * params.outpost_hole[0];
-    score += (outpost_hole_count[WHITE][1] - outpost_hole_count[BLACK][1]) * params.outpost_hole[1];
-    score += (outpost_half_count[WHITE][0] - outpost_half_count[BLACK][0]) * params.outpost_half[0];
-    score += (outpost_half_count[WHITE][1] - outpost_half_count[BLACK][1]) * params.outpost_half[1];
-
-    score += (rook_behind[WHITE][0] - rook_behind[BLACK][0]) * params.pos_r_behind_own_passer;
-    score += (rook_behind[WHITE][1] - rook_behind[BLACK][1]) * params.pos_r_behind_enemy_passer;
+    score += int16_t(rook_behind[WHITE][0] - rook_behind[BLACK][0]) * params.pos_r_behind_own_passer;
+    score += int16_t(rook_behind[WHITE][1] - rook_behind[BLACK][1]) * params.pos_r_behind_enemy_passer;
 
     // Update attacks
     data.update_attacks(WHITE, PAWN, pawns::left_attacks<WHITE>(board.bb_pieces[WHITE][PAWN]));
@@ -329,48 +327,32 @@ v4si_t evaluator_t::eval_pawns(const board_t &board, eval_data_t &data, float &t
 
     // King safety
     if(board.bb_pieces[BLACK][ROOK] || board.bb_pieces[BLACK][QUEEN]) {
-        if(data.king_circle[WHITE] & open_files) {
-            data.king_danger[WHITE] += params.kat_open_file;
-        } else if(data.king_circle[WHITE] & half_open_files[WHITE]) {
-            data.king_danger[WHITE] += params.kat_own_half_open_file;
-        } else if(data.king_circle[WHITE] & half_open_files[BLACK]) {
-            data.king_danger[WHITE] += params.kat_other_half_open_file;
-        }
+        data.king_danger[WHITE] += shelter[WHITE]->get_file_danger();
     }
     if(board.bb_pieces[WHITE][ROOK] || board.bb_pieces[WHITE][QUEEN]) {
-        if(data.king_circle[BLACK] & open_files) {
-            data.king_danger[BLACK] += params.kat_open_file;
-        } else if(data.king_circle[BLACK] & half_open_files[BLACK]) {
-            data.king_danger[BLACK] += params.kat_own_half_open_file;
-        } else if(data.king_circle[BLACK] & half_open_files[WHITE]) {
-            data.king_danger[BLACK] += params.kat_other_half_open_file;
-        }
+        data.king_danger[BLACK] += shelter[BLACK]->get_file_danger();
     }
 
-    score += params.ks_pawn_shield[pawn_shield_w];
-    score -= params.ks_pawn_shield[pawn_shield_b];
-    data.king_danger[WHITE] -= params.kat_defence_weight[PAWN] * pawn_shield_w;
-    data.king_danger[WHITE] += params.kat_attack_weight[PAWN] * pop_count(defended[BLACK] & data.king_circle[WHITE]);
-    data.king_danger[BLACK] -= params.kat_defence_weight[PAWN] * pawn_shield_b;
-    data.king_danger[BLACK] += params.kat_attack_weight[PAWN] * pop_count(defended[WHITE] & data.king_circle[BLACK]);
+    data.king_danger[WHITE] += shelter[WHITE]->get_pawn_danger();
+    data.king_danger[BLACK] += shelter[BLACK]->get_pawn_danger();
 
     return score;
 }
 
-v4si_t evaluator_t::eval_threats(const board_t &board, eval_data_t &data) {
-    v4si_t score = {0, 0, 0, 0};
+v4hi_t evaluator_t::eval_threats(const board_t &board, eval_data_t &data) {
+    v4hi_t score = {0, 0, 0, 0};
     for(int target = PAWN; target < KING; target++) {
         int undefended[2] = {pop_count(board.bb_pieces[WHITE][target] & ~data.team_attacks[WHITE]),
                              pop_count(board.bb_pieces[BLACK][target] & ~data.team_attacks[BLACK])};
         int overprotected[2] = {pop_count(board.bb_pieces[WHITE][target] & data.double_attacks[WHITE] & ~data.double_attacks[BLACK]),
                                 pop_count(board.bb_pieces[BLACK][target] & data.double_attacks[BLACK] & ~data.double_attacks[WHITE])};
-        score += (undefended[WHITE] - undefended[BLACK]) * params.undefended[target];
-        score += (overprotected[WHITE] - overprotected[BLACK]) * params.overprotected[target];
+        score += int16_t(undefended[WHITE] - undefended[BLACK]) * params.undefended[target];
+        score += int16_t(overprotected[WHITE] - overprotected[BLACK]) * params.overprotected[target];
 
         for(int attacker = PAWN; attacker < QUEEN; attacker++) {
             int attacks[2] = {pop_count(board.bb_pieces[BLACK][target] & data.attacks[WHITE][attacker]),
                            pop_count(board.bb_pieces[WHITE][target] & data.attacks[BLACK][attacker])};
-            score += (attacks[WHITE] - attacks[BLACK]) * params.threat_matrix[attacker][target];
+            score += int16_t(attacks[WHITE] - attacks[BLACK]) * params.threat_matrix[attacker][target];
         }
     }
 
@@ -380,8 +362,8 @@ v4si_t evaluator_t::eval_threats(const board_t &board, eval_data_t &data) {
     return score;
 }
 
-v4si_t evaluator_t::eval_positional(const board_t &board, eval_data_t &data) {
-    v4si_t score = {0, 0, 0, 0};
+v4hi_t evaluator_t::eval_positional(const board_t &board, eval_data_t &data) {
+    v4hi_t score = {0, 0, 0, 0};
 
     if(board.record.back().material.info.w_bishops >= 2) {
         score += params.pos_bishop_pair;
@@ -406,19 +388,21 @@ v4si_t evaluator_t::eval_positional(const board_t &board, eval_data_t &data) {
     }
 
     // Rook trapped without castling
-    if(((board.bb_pieces[WHITE][ROOK] & single_bit(rel_sq(WHITE, A1)))
-        && (board.bb_pieces[WHITE][KING] & (bits_between(rel_sq(WHITE, A1), rel_sq(WHITE, E1)))))
-       || ((board.bb_pieces[WHITE][ROOK] & single_bit(rel_sq(WHITE, H1)))
-       && (board.bb_pieces[WHITE][KING] & (bits_between(rel_sq(WHITE, E1), rel_sq(WHITE, H1)))))) {
+    if (rook_trapped<WHITE>(board)) {
         score += params.pos_r_trapped;
     }
 
-    if((((board.bb_pieces[BLACK][ROOK] & single_bit(rel_sq(BLACK, A1)))
-         && (board.bb_pieces[BLACK][KING] & (bits_between(rel_sq(BLACK, A1), rel_sq(BLACK, E1)))))
-        || ((board.bb_pieces[BLACK][ROOK] & single_bit(rel_sq(BLACK, H1)))
-            && (board.bb_pieces[BLACK][KING] & (bits_between(rel_sq(BLACK, E1), rel_sq(BLACK, H1)))))))  {
+    if (rook_trapped<BLACK>(board)) {
         score -= params.pos_r_trapped;
     }
 
     return score;
 }
+
+template<Team TEAM>
+bool evaluator_t::rook_trapped(const board_t &board) {
+    return ((board.bb_pieces[TEAM][ROOK] & single_bit(rel_sq(TEAM, A1)))
+            && (board.bb_pieces[TEAM][KING] & (bits_between(rel_sq(TEAM, A1), rel_sq(TEAM, E1)))))
+           || ((board.bb_pieces[TEAM][ROOK] & single_bit(rel_sq(TEAM, H1)))
+               && (board.bb_pieces[TEAM][KING] & (bits_between(rel_sq(TEAM, E1), rel_sq(TEAM, H1)))));
+}
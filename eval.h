@@ -9,7 +9,10 @@
 
 #include "types.h"
 #include "board.h"
+#include "attacks.h"
 #include "pawns.h"
+#include "endgame.h"
+#include "nnue.h"
 
 // lq: 0.0633654
 struct eval_params_t {
@@ -230,19 +233,205 @@ struct eval_params_t {
     // TODO: Evaluate better
 };
 
+// Fixed-point tapering factor equal to 1
+constexpr int TAPER_SCALE = 1024;
+
+/**
+ * Evaluation parameters prepared for the evaluator. The scores are packed into 16 bit lanes, and hide the tunable
+ * 32 bit parameters of the same name.
+ *
+ * Preparation is constexpr, so that the default parameters can be prepared at compile time.
+ */
 struct processed_params_t : public eval_params_t {
-    explicit processed_params_t(const eval_params_t &params);
+    constexpr explicit processed_params_t(const eval_params_t &params);
+
+    v4hi_t pst[2][6][64] = {}; // [TEAM][PIECE][SQUARE][MG/EG]
+    v4hi_t kat_table[128] = {};
+
+    // Pawn structure
+    v4hi_t isolated[2] = {}, backwards[2] = {}, semi_backwards[2] = {}, paired[2] = {}, detached[2] = {},
+            doubled[2] = {};
+    v4hi_t chain[5] = {}, passed[6] = {}, candidate[4] = {};
+
+    // Interaction of pieces and pawn structure
+    v4hi_t king_tropism[2] = {}, passer_tropism[2] = {}, blocked[2] = {};
+    v4hi_t pos_r_open_file = {}, pos_r_own_half_open_file = {}, pos_r_other_half_open_file = {};
+    v4hi_t outpost[2] = {}, outpost_hole[2] = {}, outpost_half[2] = {};
+    v4hi_t ks_pawn_shield[4] = {};
+
+    // Dynamic threats
+    v4hi_t undefended[5] = {}, overprotected[5] = {}, threat_matrix[4][5] = {};
+
+    // Other positional factors
+    v4hi_t pos_bishop_pair = {}, mat_opp_bishop[3] = {};
+    v4hi_t pos_r_trapped = {}, pos_r_behind_own_passer = {}, pos_r_behind_enemy_passer = {};
+    v4hi_t pos_mob[4] = {};
+private:
+    // Vector lanes can not be assigned one at a time in constant expressions, so scores are converted as a whole
+    static constexpr v4hi_t pack(v4si_t score) {
+        return v4hi_t{int16_t(score[0]), int16_t(score[1]), int16_t(score[2]), int16_t(score[3])};
+    }
+
+    template<size_t N>
+    static constexpr void pack(v4hi_t (&packed)[N], const v4si_t (&scores)[N]) {
+        for (size_t i = 0; i < N; i++) packed[i] = pack(scores[i]);
+    }
 
-    v4si_t pst[2][6][64] = {}; // [TEAM][PIECE][SQUARE][MG/EG]
-    v4si_t kat_table[128] = {};
+    // Exponential function for constant expressions, accurate to a few units in the last place
+    static constexpr double exp(double x) {
+        constexpr double LN2 = 0.693147180559945309417;
+        int k = int(x / LN2 + (x < 0 ? -0.5 : 0.5));
+        double r = x - k * LN2;
+
+        // Taylor series of the remainder, which is at most ln(2) / 2
+        double term = 1, sum = 1;
+        for (int i = 1; i < 20; i++) {
+            term *= r / i;
+            sum += term;
+        }
+
+        for (; k > 0; k--) sum *= 2;
+        for (; k < 0; k++) sum /= 2;
+        return sum;
+    }
+
+    static constexpr int16_t kat_sigmoid(int max, int translate, int scale, int i) {
+        return int16_t(double(max) / (1 + exp((translate - i) * double(scale) / 1024.0)));
+    }
 };
 
+constexpr processed_params_t::processed_params_t(const eval_params_t &params)
+        : eval_params_t(params) {
+    // Four-way mirrored tables
+    constexpr uint8_t square_mapping[16][4] = {{A4, A5, H4, H5},
+                                               {B4, B5, G4, G5},
+                                               {C4, C5, F4, F5},
+                                               {D4, D5, E4, E5},
+                                               {A3, A6, H3, H6},
+                                               {B3, B6, G3, G6},
+                                               {C3, C6, F3, F6},
+                                               {D3, D6, E3, E6},
+                                               {A2, A7, H2, H7},
+                                               {B2, B7, G2, G7},
+                                               {C2, C7, F2, F7},
+                                               {D2, D7, E2, E7},
+                                               {A1, A8, H1, H8},
+                                               {B1, B8, G1, G8},
+                                               {C1, C8, F1, F8},
+                                               {D1, D8, E1, E8}};
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 4; j++) {
+            pst[WHITE][KNIGHT][square_mapping[i][j]] = pack(params.n_pst[i]);
+            pst[WHITE][BISHOP][square_mapping[i][j]] = pack(params.b_pst[i]);
+            pst[WHITE][ROOK][square_mapping[i][j]] = pack(params.r_pst[i]);
+            pst[WHITE][QUEEN][square_mapping[i][j]] = pack(params.q_pst[i]);
+            pst[WHITE][KING][square_mapping[i][j]] = pack(params.k_pst[i]);
+        }
+    }
+
+    // Vertically mirrored tables
+    for (uint8_t sq = 0; sq < 64; sq++) {
+        int param_index = 32 - (4 - (file_index(sq) % 4) + rank_index(sq) * 4);
+
+        if (sq >= 8 && sq < 56) {
+            pst[WHITE][PAWN][sq] = pack(params.p_pst[param_index - 4]);
+        }
+    }
+
+    // Mirror PST for black
+    for (int piece = 0; piece < 6; piece++) {
+        for (int square = 0; square < 64; square++) {
+            pst[BLACK][piece][MIRROR_TABLE[square]] = pst[WHITE][piece][square];
+        }
+    }
+
+    // Pack scores
+    pack(isolated, params.isolated);
+    pack(backwards, params.backwards);
+    pack(semi_backwards, params.semi_backwards);
+    pack(paired, params.paired);
+    pack(detached, params.detached);
+    pack(doubled, params.doubled);
+    pack(chain, params.chain);
+    pack(passed, params.passed);
+    pack(candidate, params.candidate);
+
+    pack(king_tropism, params.king_tropism);
+    pack(passer_tropism, params.passer_tropism);
+    pack(blocked, params.blocked);
+    pos_r_open_file = pack(params.pos_r_open_file);
+    pos_r_own_half_open_file = pack(params.pos_r_own_half_open_file);
+    pos_r_other_half_open_file = pack(params.pos_r_other_half_open_file);
+    pack(outpost, params.outpost);
+    pack(outpost_hole, params.outpost_hole);
+    pack(outpost_half, params.outpost_half);
+    pack(ks_pawn_shield, params.ks_pawn_shield);
+
+    pack(undefended, params.undefended);
+    pack(overprotected, params.overprotected);
+    for (int attacker = 0; attacker < 4; attacker++) {
+        pack(threat_matrix[attacker], params.threat_matrix[attacker]);
+    }
+
+    pos_bishop_pair = pack(params.pos_bishop_pair);
+    pack(mat_opp_bishop, params.mat_opp_bishop);
+    pos_r_trapped = pack(params.pos_r_trapped);
+    pos_r_behind_own_passer = pack(params.pos_r_behind_own_passer);
+    pos_r_behind_enemy_passer = pack(params.pos_r_behind_enemy_passer);
+    pack(pos_mob, params.pos_mob);
+
+    // Set up king safety evaluation table.
+    for (int i = 0; i < 128; i++) {
+        // Translated + scaled sigmoid function
+        kat_table[i] = v4hi_t{
+                kat_sigmoid(params.kat_table_max[0], params.kat_table_translate, params.kat_table_scale, i),
+                kat_sigmoid(params.kat_table_max[1], params.kat_table_translate, params.kat_table_scale, i),
+                kat_sigmoid(params.kat_table_max[2], params.kat_table_translate, params.kat_table_scale, i),
+                kat_sigmoid(params.kat_table_max[3], params.kat_table_translate, params.kat_table_scale, i)
+        };
+    }
+}
+
+// The tuners evaluate with parameters chosen at runtime. Other builds always evaluate with the default parameters,
+// which are prepared at compile time so that the evaluator can fold them into its code.
+#if defined(TEXEL_TUNE) || defined(TOPPLE_TUNE)
+#define TOPPLE_RUNTIME_PARAMS
+#endif
+
+inline constexpr processed_params_t DEFAULT_PARAMS{eval_params_t{}};
+
 class alignas(64) evaluator_t {
+    // Game phase, endgame scaling and specialised evaluation of a material balance
+    struct material_entry_t {
+        U64 key = ~U64(0); // Never a valid material hash
+        int16_t phase; // Out of TAPER_SCALE
+        uint8_t scale[2]; // [TEAM ahead]
+        eg_eval_fn evaluator;
+    };
+
+    static constexpr size_t MATERIAL_TABLE_SIZE = 8192;
+    static constexpr size_t KING_HASH_SIZE = 16384;
+
     pawns::structure_t *pawn_hash_table;
     size_t pawn_hash_entries;
 
+    pawns::king_shelter_t *king_hash_table;
+
+    material_entry_t *material_table;
+
+#ifdef TOPPLE_RUNTIME_PARAMS
     const processed_params_t &params;
+#else
+    static constexpr const processed_params_t &params = DEFAULT_PARAMS;
+#endif
 public:
+    /**
+     * Create an evaluator
+     *
+     * @param params evaluation parameters, which are only used by builds with TOPPLE_RUNTIME_PARAMS, and must then
+     *               outlive the evaluator
+     * @param pawn_hash_size size of the pawn hash table in bytes
+     */
     evaluator_t(const processed_params_t &params, size_t pawn_hash_size);
 
     ~evaluator_t();
@@ -251,13 +440,56 @@ public:
 
     int evaluate(const board_t &board);
 
+    /**
+     * Evaluate a position, taking piece attacks from an attack map, which is built for the position if it is not
+     * current
+     */
+    int evaluate(const board_t &board, attack_map_t &attacks);
+
     void prefetch(U64 pawn_hash);
 
+    /**
+     * Evaluate with a neural network instead of the hand-crafted evaluation. Known endgames still use their
+     * specialised evaluation.
+     *
+     * @param network network, which must outlive the evaluator, or nullptr for the hand-crafted evaluation
+     */
+    void set_network(const nnue::network_t *network);
+
     /// Initialise generic evaluation tables
     static void eval_init();
 
     [[nodiscard]] float game_phase(const board_t &board) const; // returns tapering factor 0-1
+
+    /**
+     * Interpolate a packed score, relative to WHITE
+     *
+     * @param score packed score
+     * @param co_phase pawn structure phase, out of TAPER_SCALE: closed positions are 1
+     * @param me_phase material phase, out of TAPER_SCALE: the opening is 1
+     * @param scale endgame scale factor of the side which is ahead, out of SCALE_NORMAL
+     */
+    static int taper(v4hi_t score, int co_phase, int me_phase, const uint8_t scale[2]);
+
+    // Probes and hits of the pawn structure, king shelter and material tables
+    struct cache_stats_t {
+        U64 pawn_probes = 0, pawn_hits = 0;
+        U64 king_probes = 0, king_hits = 0;
+        U64 material_probes = 0, material_hits = 0;
+    };
+
+    [[nodiscard]] const cache_stats_t &get_stats() const { return stats; }
+    void reset_stats() { stats = {}; }
 private:
+    cache_stats_t stats;
+
+    const nnue::network_t *network = nullptr;
+    nnue::accumulator_stack_t accumulators;
+
+    [[nodiscard]] int game_phase(material_data_t material) const;
+
+    const material_entry_t &probe_material(material_data_t material);
+
     struct eval_data_t {
         int king_pos[2];
         U64 king_circle[2];
@@ -274,13 +506,22 @@ private:
         }
     };
 
-    v4si_t eval_pawns(const board_t &board, eval_data_t &data, float &taper);
+    v4hi_t eval_pawns(const board_t &board, eval_data_t &data, int &taper);
+
+    v4hi_t eval_pieces(const board_t &board, const attack_map_t &attacks, eval_data_t &data);
+
+    // Pieces of one type and side, relative to that side
+    template<Team TEAM>
+    v4hi_t eval_pieces(const board_t &board, Piece type, const attack_map_t &attacks, U64 double_attack_mask,
+                       eval_data_t &data);
 
-    v4si_t eval_pieces(const board_t &board, eval_data_t &data);
+    // Rook shut in by its own uncastled king
+    template<Team TEAM>
+    static bool rook_trapped(const board_t &board);
 
-    v4si_t eval_threats(const board_t &board, eval_data_t &data);
+    v4hi_t eval_threats(const board_t &board, eval_data_t &data);
 
-    v4si_t eval_positional(const board_t &board, eval_data_t &data);
+    v4hi_t eval_positional(const board_t &board, eval_data_t &data);
 };
 
 #endif //TOPPLE_EVAL_H
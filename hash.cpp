@@ -5,7 +5,9 @@
 #include <random>
 #include <memory>
 #include <cstring>
+#include <cstdlib>
 #include "hash.h"
+#include "bb.h"
 
 namespace zobrist {
     const U64 seed = 0xBEEF;
@@ -15,6 +17,37 @@ namespace zobrist {
     U64 ep[64];
     U64 castle[2][2];
 
+    U64 cuckoo[CUCKOO_SIZE];
+    uint8_t cuckoo_squares[CUCKOO_SIZE][2];
+
+    void init_cuckoo() {
+        std::memset(cuckoo, 0, sizeof(cuckoo));
+        std::memset(cuckoo_squares, 0, sizeof(cuckoo_squares));
+
+        for (uint8_t team = 0; team < 2; team++) {
+            for (uint8_t piece = KNIGHT; piece <= KING; piece++) {
+                for (uint8_t a = 0; a < 64; a++) {
+                    for (uint8_t b = a + 1; b < 64; b++) {
+                        if (!(find_moves(Piece(piece), Team(team), a, 0) & single_bit(b))) continue;
+
+                        // Insert, displacing entries to their other slot until an empty slot is found
+                        U64 key = squares[a][team][piece] ^ squares[b][team][piece] ^ side;
+                        uint8_t move[2] = {a, b};
+                        size_t i = cuckoo_h1(key);
+                        while (true) {
+                            std::swap(cuckoo[i], key);
+                            std::swap(cuckoo_squares[i][0], move[0]);
+                            std::swap(cuckoo_squares[i][1], move[1]);
+                            if (!key) break;
+
+                            i = i == cuckoo_h1(key) ? cuckoo_h2(key) : cuckoo_h1(key);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     void init_hashes() {
         std::mt19937_64 gen(seed);
         std::uniform_int_distribution<U64> dist;
@@ -31,6 +64,8 @@ namespace zobrist {
                     squares[i][j][k] = dist(gen);
             ep[i] = dist(gen);
         }
+
+        init_cuckoo();
     }
 }
 
@@ -71,19 +106,29 @@ bool tt::hash_t::probe(U64 hash, tt::entry_t &entry) {
 }
 
 void tt::hash_t::save(Bound bound, U64 hash, int depth, int ply, int static_eval, int score, move_t move) {
-    const size_t index = (hash & num_entries) * bucket_size;
-    tt::entry_t *bucket = table + index;
-
     if (score >= MINCHECKMATE) score += ply;
     if (score <= -MINCHECKMATE) score -= ply;
 
     tt::entry_t updated = {};
-    updated.info.move = compress(move);
+    updated.info.move = move;
     updated.info.static_eval = static_cast<int16_t>(static_eval);
     updated.info.internal_value = static_cast<int16_t>(score);
     updated.info.about = uint16_t(bound) | (uint16_t(depth) << 2u) | (generation << 10u);
     updated.coded_hash = hash ^ updated.data;
 
+    store(hash, bound, depth, updated);
+
+    // Tablebase results are saved with MAX_PLY depth, and are cheap to find again
+    if (export_depth && depth >= export_depth && depth < MAX_PLY) {
+        std::lock_guard<std::mutex> lock(export_mtx);
+        if (exports.size() < max_exports) exports.push_back(updated);
+    }
+}
+
+void tt::hash_t::store(U64 hash, Bound bound, int depth, const entry_t &updated) {
+    const size_t index = (hash & num_entries) * bucket_size;
+    tt::entry_t *bucket = table + index;
+
     if((bucket->coded_hash ^ bucket->data) == hash) {
         if(bound == EXACT || depth >= bucket->depth() - 2) {
             *bucket = updated;
@@ -107,6 +152,30 @@ void tt::hash_t::save(Bound bound, U64 hash, int depth, int ply, int static_eval
     *replace = updated;
 }
 
+void tt::hash_t::set_export_depth(int depth) {
+    std::lock_guard<std::mutex> lock(export_mtx);
+    export_depth = depth;
+    if (!depth) exports.clear();
+}
+
+void tt::hash_t::drain_exports(std::vector<entry_t> &entries) {
+    std::lock_guard<std::mutex> lock(export_mtx);
+    entries.insert(entries.end(), exports.begin(), exports.end());
+    exports.clear();
+}
+
+bool tt::hash_t::import(entry_t entry) {
+    if (entry.bound() == NONE || entry.depth() >= MAX_PLY
+        || std::abs(entry.info.internal_value) > INF || std::abs(entry.info.static_eval) > INF) {
+        return false;
+    }
+
+    U64 hash = entry.coded_hash ^ entry.data;
+    entry.refresh(generation);
+    store(hash, entry.bound(), entry.depth(), entry);
+    return true;
+}
+
 void tt::hash_t::age() {
     generation++;
     if(generation >= 63) {
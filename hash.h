@@ -5,7 +5,9 @@
 #ifndef TOPPLE_HASH_H
 #define TOPPLE_HASH_H
 
+#include <atomic>
 #include <mutex>
+#include <vector>
 
 #include "types.h"
 #include "move.h"
@@ -17,7 +19,18 @@ namespace zobrist {
     extern U64 castle[2][2];
 
     /**
-     * Initialise the hash arrays
+     * Cuckoo table of the hash differences made by every reversible move of a piece between two squares, used to detect
+     * in constant time whether a single move returns to an earlier position. Indexed by cuckoo_h1 or cuckoo_h2.
+     */
+    constexpr size_t CUCKOO_SIZE = 8192;
+    extern U64 cuckoo[CUCKOO_SIZE];
+    extern uint8_t cuckoo_squares[CUCKOO_SIZE][2];
+
+    inline size_t cuckoo_h1(U64 key) { return key & (CUCKOO_SIZE - 1); }
+    inline size_t cuckoo_h2(U64 key) { return (key >> 16u) & (CUCKOO_SIZE - 1); }
+
+    /**
+     * Initialise the hash arrays. Bitboard tables must be initialised first.
      */
     void init_hashes();
 }
@@ -138,7 +151,7 @@ namespace tt {
         U64 coded_hash; // 8 bytes
         union {
             struct {
-                packed_move_t move;
+                move_t move;
                 int16_t static_eval;
                 int16_t internal_value;
                 uint16_t about; // 6G 8D 2B
@@ -197,10 +210,38 @@ namespace tt {
         void save(Bound bound, U64 hash, int depth, int ply, int static_eval, int score, move_t move);
         void age();
         size_t hash_full();
+
+        /**
+         * Copy entries saved with at least the given depth to an export buffer, to be shared with other processes.
+         * Zero disables exporting.
+         */
+        void set_export_depth(int depth);
+
+        /**
+         * Move the exported entries to {@code entries}
+         */
+        void drain_exports(std::vector<entry_t> &entries);
+
+        /**
+         * Store an entry exported by another table, using the normal replacement scheme. Imported entries are not
+         * exported again. Entries without a bound, with a depth no search saves, or with a score out of range are
+         * rejected. The move is not checked here, as it is checked for pseudo-legality whenever it is probed.
+         *
+         * @return whether the entry was stored
+         */
+        bool import(entry_t entry);
     private:
+        static constexpr size_t max_exports = 4096;
+
+        void store(U64 hash, Bound bound, int depth, const entry_t &updated);
+
         size_t num_entries;
         unsigned generation = 1;
         entry_t *table;
+
+        std::atomic_int export_depth{0};
+        std::mutex export_mtx;
+        std::vector<entry_t> exports;
     };
 }
 
@@ -11,35 +11,20 @@
 #include <iostream>
 
 /**
- * Represents a move in the game
+ * Represents a move in the game, as its squares and any promotion. Everything else about the move, such as the moving
+ * and captured pieces, is looked up on the board it is played on.
  */
-#pragma pack(push, 1)
 union move_t {
     struct {
-        uint8_t from;
-        uint8_t to;
-
-        uint16_t team : 1,
-                piece: 3,
-                is_capture: 1,
-                captured_type: 3,
-                is_promotion: 1,
-                promotion_type: 3,
-                castle: 1,
-                castle_side: 1,
-                is_ep: 1,
-                : 1; // 16 bits
+        uint16_t from : 6,
+                to : 6,
+                promotion_type : 4; // Piece promoted to, or 0 if the move does not promote
     } info;
 
-    uint32_t hash;
+    uint16_t hash;
 };
 
-struct packed_move_t {
-    uint16_t from : 6,
-    to: 6,
-    type: 4;
-};
-#pragma pack(pop)
+static_assert(sizeof(move_t) == 2);
 
 constexpr move_t EMPTY_MOVE = {};
 
@@ -57,7 +42,7 @@ inline std::ostream &operator<<(std::ostream &stream, const move_t &move) {
     } else {
         stream << from_sq(move.info.from) << from_sq(move.info.to);
 
-        if (move.info.is_promotion) {
+        if (move.info.promotion_type) {
             switch (move.info.promotion_type) {
                 case KNIGHT:
                     stream << "n";
@@ -80,27 +65,17 @@ inline std::ostream &operator<<(std::ostream &stream, const move_t &move) {
     return stream;
 }
 
-inline move_t reverse(move_t &move) {
-    if(!move.info.is_ep && !move.info.is_capture && !move.info.is_promotion && !move.info.castle) {
-        move_t reversed = move;
-        reversed.info.from = move.info.to;
-        reversed.info.to = move.info.from;
-
-        return reversed;
-    }
-
-    return EMPTY_MOVE;
+inline bool is_promotion(move_t move) {
+    return move.info.promotion_type != 0;
 }
 
-inline packed_move_t compress(move_t move) {
-    packed_move_t packed_move{};
-    packed_move.from = move.info.from;
-    packed_move.to = move.info.to;
-    if(move.info.is_promotion) {
-        packed_move.type = move.info.promotion_type;
-    }
+// The same piece moving back, which is only meaningful for quiet moves
+inline move_t reverse(move_t move) {
+    move_t reversed = EMPTY_MOVE;
+    reversed.info.from = move.info.to;
+    reversed.info.to = move.info.from;
 
-    return packed_move;
+    return reversed;
 }
 
 #endif //TOPPLE_MOVE_H
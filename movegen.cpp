@@ -11,93 +11,114 @@ constexpr U64 PROMOTING[2] = {
 };
 
 movegen_t::movegen_t(const board_t &board) : board(board) {
-    team = board.record.back().next_move;
-    x_team = Team(!board.record.back().next_move);
 }
 
+movegen_t::movegen_t(const board_t &board, const attack_map_t &attacks) : board(board), attacks(&attacks) {
+}
+
+int movegen_t::gen_normal(move_t *buf) {
+    return board.record.back().next_move == WHITE ? gen_normal<WHITE>(buf) : gen_normal<BLACK>(buf);
+}
+
+int movegen_t::gen_noisy(move_t *buf) {
+    return board.record.back().next_move == WHITE ? gen_noisy<WHITE>(buf) : gen_noisy<BLACK>(buf);
+}
+
+int movegen_t::gen_quiets(move_t *buf) {
+    return board.record.back().next_move == WHITE ? gen_quiets<WHITE>(buf) : gen_quiets<BLACK>(buf);
+}
+
+int movegen_t::gen_evasions(move_t *buf) {
+    return board.record.back().next_move == WHITE ? gen_evasions<WHITE>(buf) : gen_evasions<BLACK>(buf);
+}
+
+template<Team TEAM>
+bool movegen_t::is_attacked(uint8_t sq) const {
+    constexpr Team X_TEAM = Team(!TEAM);
+    return attacks ? (attacks->sides[X_TEAM] & single_bit(sq)) != 0 : board.is_attacked(sq, X_TEAM);
+}
+
+template<Team TEAM, Piece TYPE>
+U64 movegen_t::piece_attacks(uint8_t from) const {
+    return attacks ? attacks->squares[from] : find_moves<TYPE>(TEAM, from, board.bb_all);
+}
+
+template<Team TEAM>
 int movegen_t::gen_normal(move_t *buf) {
-    int noisy = gen_noisy(buf);
-    int quiets = gen_quiets(buf + noisy);
+    int noisy = gen_noisy<TEAM>(buf);
+    int quiets = gen_quiets<TEAM>(buf + noisy);
 
     return noisy + quiets;
 }
 
+template<Team TEAM>
 int movegen_t::gen_noisy(move_t *buf) {
+    constexpr Team X_TEAM = Team(!TEAM);
+
     // En-passant capture
-    int buf_size = gen_ep(buf);
+    int buf_size = gen_ep<TEAM>(buf);
 
     // Promotions
-    buf_size += gen_prom(buf + buf_size);
+    buf_size += gen_prom<TEAM>(buf + buf_size);
 
     move_t move = EMPTY_MOVE;
-    move.info.team = team;
-    move.info.is_capture = 1;
 
     // Pawn caps
-    move.info.piece = PAWN;
-    U64 bb_pawns = board.bb_pieces[team][PAWN] & ~PROMOTING[team];
+    U64 bb_pawns = board.bb_pieces[TEAM][PAWN] & ~PROMOTING[TEAM];
 
     while (bb_pawns) {
         uint8_t from = pop_bit(bb_pawns);
         move.info.from = from;
 
-        U64 bb_targets = pawn_caps(team, from) & board.bb_side[x_team];
+        U64 bb_targets = pawn_caps(TEAM, from) & board.bb_side[X_TEAM];
 
         while (bb_targets) {
             uint8_t to = pop_bit(bb_targets);
             move.info.to = to;
-            move.info.captured_type = board.sq_data[to].piece;
 
             buf[buf_size++] = move;
         }
     }
 
     // Generate piece caps (not pawns)
-    gen_piece_caps<KNIGHT>(buf, buf_size, move);
-    gen_piece_caps<BISHOP>(buf, buf_size, move);
-    gen_piece_caps<ROOK>(buf, buf_size, move);
-    gen_piece_caps<QUEEN>(buf, buf_size, move);
-    gen_piece_caps<KING>(buf, buf_size, move);
+    gen_piece_caps<TEAM, KNIGHT>(buf, buf_size, move);
+    gen_piece_caps<TEAM, BISHOP>(buf, buf_size, move);
+    gen_piece_caps<TEAM, ROOK>(buf, buf_size, move);
+    gen_piece_caps<TEAM, QUEEN>(buf, buf_size, move);
+    gen_piece_caps<TEAM, KING>(buf, buf_size, move);
 
     return buf_size;
 }
 
+template<Team TEAM>
 int movegen_t::gen_castling(move_t *buf) {
     int buf_size = 0;
     move_t move{};
 
     // Generate castling kingside
-    if (board.record.back().castle[team][0]) {
-        if ((board.bb_all & bits_between(team ? E8 : E1, team ? H8 : H1)) == 0 &&
-            !board.is_attacked(team ? E8 : E1, x_team) &&
-            !board.is_attacked(team ? F8 : F1, x_team) &&
-            !board.is_attacked(team ? G8 : G1, x_team)) {
+    if (board.record.back().castle[TEAM][0]) {
+        if ((board.bb_all & bits_between(rel_sq(TEAM, E1), rel_sq(TEAM, H1))) == 0 &&
+            !is_attacked<TEAM>(rel_sq(TEAM, E1)) &&
+            !is_attacked<TEAM>(rel_sq(TEAM, F1)) &&
+            !is_attacked<TEAM>(rel_sq(TEAM, G1))) {
             // No pieces between, we can castle!
             move = EMPTY_MOVE;
-            move.info.piece = KING;
-            move.info.team = team;
-            move.info.from = team ? E8 : E1;
-            move.info.to = team ? G8 : G1;
-            move.info.castle = 1;
-            move.info.castle_side = 0;
+            move.info.from = rel_sq(TEAM, E1);
+            move.info.to = rel_sq(TEAM, G1);
             buf[buf_size++] = move;
         }
     }
 
     // Generate castling queenside
-    if (board.record.back().castle[team][1]) {
-        if ((board.bb_all & bits_between(team ? E8 : E1, team ? A8 : A1)) == 0 &&
-            !board.is_attacked(team ? E8 : E1, x_team) &&
-            !board.is_attacked(team ? D8 : D1, x_team) &&
-            !board.is_attacked(team ? C8 : C1, x_team)) {
+    if (board.record.back().castle[TEAM][1]) {
+        if ((board.bb_all & bits_between(rel_sq(TEAM, E1), rel_sq(TEAM, A1))) == 0 &&
+            !is_attacked<TEAM>(rel_sq(TEAM, E1)) &&
+            !is_attacked<TEAM>(rel_sq(TEAM, D1)) &&
+            !is_attacked<TEAM>(rel_sq(TEAM, C1))) {
             // No pieces between, we can castle!
             move = EMPTY_MOVE;
-            move.info.piece = KING;
-            move.info.team = team;
-            move.info.from = team ? E8 : E1;
-            move.info.to = team ? C8 : C1;
-            move.info.castle = 1;
-            move.info.castle_side = 1;
+            move.info.from = rel_sq(TEAM, E1);
+            move.info.to = rel_sq(TEAM, C1);
             buf[buf_size++] = move;
         }
     }
@@ -105,26 +126,24 @@ int movegen_t::gen_castling(move_t *buf) {
     return buf_size;
 }
 
+template<Team TEAM>
 int movegen_t::gen_prom(move_t *buf) {
+    constexpr Team X_TEAM = Team(!TEAM);
+
     int buf_size = 0;
     move_t move = EMPTY_MOVE;
-    move.info.team = team;
-    move.info.piece = PAWN;
-    move.info.is_promotion = 1;
 
     // Capturing promotions
-    move.info.is_capture = 1;
-    U64 bb_promotable = board.bb_pieces[team][PAWN] & PROMOTING[team];
+    U64 bb_promotable = board.bb_pieces[TEAM][PAWN] & PROMOTING[TEAM];
     while (bb_promotable) {
         uint8_t from = pop_bit(bb_promotable);
         move.info.from = from;
 
-        U64 bb_targets = pawn_caps(team, from) & board.bb_side[x_team];
+        U64 bb_targets = pawn_caps(TEAM, from) & board.bb_side[X_TEAM];
 
         while (bb_targets) {
             uint8_t to = pop_bit(bb_targets);
             move.info.to = to;
-            move.info.captured_type = board.sq_data[to].piece;
 
             // Promotions
             for (uint8_t i = QUEEN; i > PAWN; i--) {
@@ -137,14 +156,12 @@ int movegen_t::gen_prom(move_t *buf) {
 
     // Non-capturing promotions
     U64 mask = ~board.bb_all;
-    move.info.is_capture = 0;
-    move.info.captured_type = 0;
-    bb_promotable = board.bb_pieces[team][PAWN] & PROMOTING[team];
+    bb_promotable = board.bb_pieces[TEAM][PAWN] & PROMOTING[TEAM];
     while (bb_promotable) {
         uint8_t from = pop_bit(bb_promotable);
         move.info.from = from;
 
-        U64 bb_targets = find_moves<PAWN>(team, from, board.bb_all) & mask;
+        U64 bb_targets = find_moves<PAWN>(TEAM, from, board.bb_all) & mask;
 
         while (bb_targets) {
             uint8_t to = pop_bit(bb_targets);
@@ -162,24 +179,22 @@ int movegen_t::gen_prom(move_t *buf) {
     return buf_size;
 }
 
+template<Team TEAM>
 int movegen_t::gen_ep(move_t *buf) {
+    constexpr Team X_TEAM = Team(!TEAM);
+
     int buf_size = 0;
     move_t move = EMPTY_MOVE;
-    move.info.team = team;
 
     // Generate en-passant capture
     if (board.record.back().ep_square != 0) {
-        U64 ep_attacks = pawn_caps(x_team, board.record.back().ep_square) & board.bb_pieces[team][PAWN];
+        U64 ep_attacks = pawn_caps(X_TEAM, board.record.back().ep_square) & board.bb_pieces[TEAM][PAWN];
 
         while (ep_attacks) {
             uint8_t from = pop_bit(ep_attacks);
 
             move.info.from = from;
-            move.info.piece = PAWN;
             move.info.to = board.record.back().ep_square;
-            move.info.is_ep = 1;
-            move.info.is_capture = 1;
-            move.info.captured_type = PAWN;
             buf[buf_size++] = move;
         }
     }
@@ -187,8 +202,9 @@ int movegen_t::gen_ep(move_t *buf) {
     return buf_size;
 }
 
+template<Team TEAM>
 int movegen_t::gen_quiets(move_t *buf) {
-    int buf_size = gen_castling(buf);
+    int buf_size = gen_castling<TEAM>(buf);
 
     // Generates quiet moves only
     U64 mask = ~board.bb_all;
@@ -196,15 +212,13 @@ int movegen_t::gen_quiets(move_t *buf) {
     // Pawn moves
     move_t move{};
     move = EMPTY_MOVE;
-    move.info.team = team;
-    move.info.piece = PAWN;
-    U64 bb_pawns = board.bb_pieces[team][PAWN] & ~PROMOTING[team];
+    U64 bb_pawns = board.bb_pieces[TEAM][PAWN] & ~PROMOTING[TEAM];
 
     while (bb_pawns) {
         uint8_t from = pop_bit(bb_pawns);
         move.info.from = from;
 
-        U64 bb_targets = find_moves<PAWN>(team, from, board.bb_all) & mask;
+        U64 bb_targets = find_moves<PAWN>(TEAM, from, board.bb_all) & mask;
 
         while (bb_targets) {
             uint8_t to = pop_bit(bb_targets);
@@ -215,26 +229,25 @@ int movegen_t::gen_quiets(move_t *buf) {
     }
 
     // Generate piece moves (not pawns)
-    gen_piece_quiets<KNIGHT>(buf, buf_size, move, mask);
-    gen_piece_quiets<BISHOP>(buf, buf_size, move, mask);
-    gen_piece_quiets<ROOK>(buf, buf_size, move, mask);
-    gen_piece_quiets<QUEEN>(buf, buf_size, move, mask);
-    gen_piece_quiets<KING>(buf, buf_size, move, mask);
+    gen_piece_quiets<TEAM, KNIGHT>(buf, buf_size, move, mask);
+    gen_piece_quiets<TEAM, BISHOP>(buf, buf_size, move, mask);
+    gen_piece_quiets<TEAM, ROOK>(buf, buf_size, move, mask);
+    gen_piece_quiets<TEAM, QUEEN>(buf, buf_size, move, mask);
+    gen_piece_quiets<TEAM, KING>(buf, buf_size, move, mask);
 
     return buf_size;
 }
 
 
-template<Piece TYPE>
+template<Team TEAM, Piece TYPE>
 void movegen_t::gen_piece_quiets(move_t *buf, int &buf_size, move_t move, U64 mask) {
-    move.info.piece = TYPE;
-    U64 bb_piece = board.bb_pieces[team][TYPE];
+    U64 bb_piece = board.bb_pieces[TEAM][TYPE];
 
     while (bb_piece) {
         uint8_t from = pop_bit(bb_piece);
         move.info.from = from;
 
-        U64 bb_targets = find_moves<TYPE>(team, from, board.bb_all) & mask;
+        U64 bb_targets = piece_attacks<TEAM, TYPE>(from) & mask;
 
         while (bb_targets) {
             uint8_t to = pop_bit(bb_targets);
@@ -245,21 +258,107 @@ void movegen_t::gen_piece_quiets(move_t *buf, int &buf_size, move_t move, U64 ma
     }
 }
 
-template<Piece TYPE>
+template<Team TEAM, Piece TYPE>
 void movegen_t::gen_piece_caps(move_t *buf, int &buf_size, move_t move) {
-    move.info.piece = TYPE;
-    U64 bb_piece = board.bb_pieces[team][TYPE];
+    U64 bb_piece = board.bb_pieces[TEAM][TYPE];
+
+    while (bb_piece) {
+        uint8_t from = pop_bit(bb_piece);
+        move.info.from = from;
+
+        U64 bb_targets = piece_attacks<TEAM, TYPE>(from) & board.bb_side[Team(!TEAM)];
+
+        while (bb_targets) {
+            uint8_t to = pop_bit(bb_targets);
+            move.info.to = to;
+
+            buf[buf_size++] = move;
+        }
+    }
+}
+
+template<Team TEAM>
+int movegen_t::gen_evasions(move_t *buf) {
+    constexpr Team X_TEAM = Team(!TEAM);
+
+    int buf_size = 0;
+    const uint8_t king_sq = bit_scan(board.bb_pieces[TEAM][KING]);
+    const U64 checkers = board.attacks_to(king_sq, TEAM);
+
+    // King moves, to squares which are not attacked once the king has left its square
+    move_t move = EMPTY_MOVE;
+    move.info.from = king_sq;
+
+    U64 occupied = board.bb_all ^ single_bit(king_sq);
+    U64 bb_targets = find_moves<KING>(TEAM, king_sq, board.bb_all) & ~board.bb_side[TEAM];
+    while (bb_targets) {
+        uint8_t to = pop_bit(bb_targets);
+        if (board.is_attacked(to, X_TEAM, occupied)) continue;
+
+        move.info.to = to;
+        buf[buf_size++] = move;
+    }
+
+    // Only the king can escape a double check
+    if (multiple_bits(checkers)) return buf_size;
+
+    const uint8_t checker_sq = bit_scan(checkers);
+    const U64 block = bits_between(king_sq, checker_sq);
+
+    // En-passant capture of a checking pawn
+    if (board.record.back().ep_square != 0 &&
+        (checkers & single_bit(uint8_t(board.record.back().ep_square + rel_offset(TEAM, D_S))))) {
+        buf_size += gen_ep<TEAM>(buf + buf_size);
+    }
+
+    // Pawn captures of the checker and pushes between the checker and the king, which may promote
+    move = EMPTY_MOVE;
+    U64 bb_pawns = board.bb_pieces[TEAM][PAWN];
+    while (bb_pawns) {
+        uint8_t from = pop_bit(bb_pawns);
+        move.info.from = from;
+        const bool promoting = (PROMOTING[TEAM] & single_bit(from)) != 0;
+
+        bb_targets = (pawn_caps(TEAM, from) & checkers) | (find_moves<PAWN>(TEAM, from, board.bb_all) & block);
+        while (bb_targets) {
+            uint8_t to = pop_bit(bb_targets);
+            move.info.to = to;
+
+            if (promoting) {
+                for (uint8_t i = QUEEN; i > PAWN; i--) {
+                    move.info.promotion_type = i;
+                    buf[buf_size++] = move;
+                }
+                move.info.promotion_type = 0;
+            } else {
+                buf[buf_size++] = move;
+            }
+        }
+    }
+
+    // Piece captures of the checker and interpositions
+    move = EMPTY_MOVE;
+    gen_piece_evasions<TEAM, KNIGHT>(buf, buf_size, move, checkers | block);
+    gen_piece_evasions<TEAM, BISHOP>(buf, buf_size, move, checkers | block);
+    gen_piece_evasions<TEAM, ROOK>(buf, buf_size, move, checkers | block);
+    gen_piece_evasions<TEAM, QUEEN>(buf, buf_size, move, checkers | block);
+
+    return buf_size;
+}
+
+template<Team TEAM, Piece TYPE>
+void movegen_t::gen_piece_evasions(move_t *buf, int &buf_size, move_t move, U64 target) {
+    U64 bb_piece = board.bb_pieces[TEAM][TYPE];
 
     while (bb_piece) {
         uint8_t from = pop_bit(bb_piece);
         move.info.from = from;
 
-        U64 bb_targets = find_moves<TYPE>(team, from, board.bb_all) & board.bb_side[x_team];
+        U64 bb_targets = piece_attacks<TEAM, TYPE>(from) & target;
 
         while (bb_targets) {
             uint8_t to = pop_bit(bb_targets);
             move.info.to = to;
-            move.info.captured_type = board.sq_data[to].piece;
 
             buf[buf_size++] = move;
         }
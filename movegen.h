@@ -7,6 +7,7 @@
 
 #include "move.h"
 #include "board.h"
+#include "attacks.h"
 
 struct board_t;
 
@@ -19,6 +20,15 @@ public:
      */
     explicit movegen_t(const board_t &board);
 
+    /**
+     * Create a move generator which takes piece attacks from an attack map of the current position, instead of looking
+     * them up again.
+     *
+     * @param board board to generate moves for
+     * @param attacks attack map, which must be current
+     */
+    movegen_t(const board_t &board, const attack_map_t &attacks);
+
     /**
      * Generate moves in the current state of the board and save them to {@code buf}, overwriting it from index 0.
      *
@@ -39,18 +49,35 @@ public:
      * @return the number of moves in {@code buf}
      */
     int gen_quiets(move_t *buf);
+
+    /**
+     * Generate the moves which may get the side to move out of check: king moves to squares which are not attacked,
+     * and unless in double check, captures of the checking piece and interpositions. Moves of pinned pieces are not
+     * filtered out.
+     *
+     * @return the number of moves in {@code buf}
+     */
+    int gen_evasions(move_t *buf);
 private:
     const board_t &board;
+    const attack_map_t *attacks = nullptr;
+
+    // Generators for the side to move, which is dispatched once by the public functions above
+    template<Team TEAM> int gen_normal(move_t *buf);
+    template<Team TEAM> int gen_noisy(move_t *buf);
+    template<Team TEAM> int gen_quiets(move_t *buf);
+    template<Team TEAM> int gen_evasions(move_t *buf);
 
-    Team team;
-    Team x_team;
+    template<Team TEAM> int gen_prom(move_t *buf);
+    template<Team TEAM> int gen_castling(move_t *buf);
+    template<Team TEAM> int gen_ep(move_t *buf);
 
-    int gen_prom(move_t *buf);
-    int gen_castling(move_t *buf);
-    int gen_ep(move_t *buf);
+    template<Team TEAM> bool is_attacked(uint8_t sq) const;
 
-    template <Piece TYPE> void gen_piece_quiets(move_t *buf, int &buf_size, move_t move, U64 mask);
-    template <Piece TYPE> void gen_piece_caps(move_t *buf, int &buf_size, move_t move);
+    template<Team TEAM, Piece TYPE> U64 piece_attacks(uint8_t from) const;
+    template<Team TEAM, Piece TYPE> void gen_piece_quiets(move_t *buf, int &buf_size, move_t move, U64 mask);
+    template<Team TEAM, Piece TYPE> void gen_piece_caps(move_t *buf, int &buf_size, move_t move);
+    template<Team TEAM, Piece TYPE> void gen_piece_evasions(move_t *buf, int &buf_size, move_t move, U64 target);
 };
 
 
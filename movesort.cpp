@@ -5,8 +5,52 @@
 #include "movesort.h"
 #include "move.h"
 
-movesort_t::movesort_t(GenMode mode,  const heuristic_set_t &heuristics, const board_t &board, move_t hash_move, move_t refutation, int ply) :
-        mode(mode), heur(heuristics), board(board), hash_move(hash_move), refutation(refutation), gen(movegen_t(board)) {
+namespace {
+    // Ordering value of the piece a noisy move wins: the captured piece plus the material a promotion adds
+    inline int victim_value(const board_t &board, move_t move) {
+        int value = board.is_capture(move) ? VAL[board.captured_piece(move)] : 0;
+        if (is_promotion(move)) value += VAL[move.info.promotion_type] - VAL[PAWN];
+        return value;
+    }
+
+    // MVV-LVA, adjusted by the capture history
+    void score_noisy(const heuristic_set_t &heur, const board_t &board, const move_t *moves, int *scores, int size) {
+        for (int i = 0; i < size; i++) {
+            scores[i] = victim_value(board, moves[i]) * 8 - board.moving_piece(moves[i])
+                        + heur.capture_history.get(board, moves[i]) / 32;
+        }
+    }
+
+    // Sort the moves scoring at least the limit in descending order at the front of the buffer, and leave the rest
+    // unsorted behind them
+    void partial_insertion_sort(move_t *moves, int *scores, int size, int limit) {
+        for (int sorted_end = 0, i = 0; i < size; i++) {
+            if (scores[i] < limit) continue;
+
+            move_t move = moves[i];
+            int score = scores[i];
+
+            // Move the first unsorted move out of the way, then shift the sorted moves that score lower
+            moves[i] = moves[sorted_end];
+            scores[i] = scores[sorted_end];
+
+            int j = sorted_end++;
+            for (; j > 0 && scores[j - 1] < score; j--) {
+                moves[j] = moves[j - 1];
+                scores[j] = scores[j - 1];
+            }
+
+            moves[j] = move;
+            scores[j] = score;
+        }
+    }
+}
+
+movesort_t::movesort_t(const heuristic_set_t &heuristics, const board_t &board, const attack_map_t &attacks,
+                       move_t hash_move, move_t refutation, int ply, int depth) :
+        heur(heuristics), board(board), attacks(attacks.is_current(board) ? &attacks : nullptr),
+        in_check(this->attacks ? attacks.is_incheck(board) : board.is_incheck()), hash_move(hash_move), refutation(refutation), depth(depth),
+        gen(this->attacks ? movegen_t(board, attacks) : movegen_t(board)) {
     killer_1 = heur.killers.primary(ply);
     killer_2 = heur.killers.secondary(ply);
     if(ply > 2) {
@@ -38,28 +82,36 @@ move_t movesort_t::next(GenStage &stage, int &score, bool skip_quiets) {
                 return hash_move;
             }
         case GEN_HASH:
-            // Generate captures
-            capt_buf_size = gen.gen_noisy(capt_buf);
+            // Generate and order captures. In check, the evasions are split into captures and quiets here instead.
+            if (in_check) {
+                int evasions = gen.gen_evasions(main_buf);
+                for (int i = 0; i < evasions; i++) {
+                    if (board.is_capture(main_buf[i]) || is_promotion(main_buf[i])) {
+                        capt_buf[capt_buf_size++] = main_buf[i];
+                    } else {
+                        main_buf[main_buf_size++] = main_buf[i];
+                    }
+                }
+            } else {
+                capt_buf_size = gen.gen_noisy(capt_buf);
+            }
+            score_noisy(heur, board, capt_buf, capt_scores, capt_buf_size);
+            partial_insertion_sort(capt_buf, capt_scores, capt_buf_size, INT32_MIN);
 
             stage = GEN_GOOD_NOISY;
         case GEN_GOOD_NOISY:
-            // Pick best capture if there are any left.
+            // Try the next capture if there are any left. Exchanges are only evaluated for captures that are reached.
             if (capt_idx < capt_buf_size) {
-                int best_idx = capt_idx;
-                for (int i = capt_idx; i < capt_buf_size; i++) {
-                    if (VAL[capt_buf[i].info.captured_type] > VAL[capt_buf[best_idx].info.captured_type]) {
-                        best_idx = i;
-                    }
-                }
-
-                buf_swap_capt(best_idx, capt_idx);
-
                 if (capt_buf[capt_idx] == hash_move) {
                     capt_idx++;
                     goto retry;
                 }
 
-                if ((score = board.see(capt_buf[capt_idx])) >= 0) {
+                // The search only needs to know that a capture does not lose material
+                bool good = attacks ? board.see_ge(capt_buf[capt_idx], 0, *attacks) : board.see_ge(capt_buf[capt_idx], 0);
+                score = 0;
+
+                if (good) {
                     return capt_buf[capt_idx++];
                 } else {
                     capt_buf[bad_capt_buf_size++] = capt_buf[capt_idx++];
@@ -67,53 +119,29 @@ move_t movesort_t::next(GenStage &stage, int &score, bool skip_quiets) {
                 }
             }
 
-            // Generate quiets if we're not in quiescence
-            if(mode != QUIESCENCE) stage = GEN_QUIETS;
-            else return EMPTY_MOVE;
+            // Generate quiets
+            stage = GEN_QUIETS;
 
             if(!skip_quiets) {
-                // Generate quiets in main buffer
-                main_buf_size = gen.gen_quiets(main_buf);
-
-                // Score quiets
-                for (int i = 0; i < main_buf_size; i++) {
-                    if (main_buf[i] == killer_1) {
-                        main_scores[i] = 1000000003;
-                    } else if (main_buf[i] == killer_2) {
-                        main_scores[i] = 1000000002;
-                    } else if (main_buf[i] == killer_3) {
-                        main_scores[i] = 1000000001;
-                    } else {
-                        main_scores[i] = heur.history.get(main_buf[i]);
-                        if (refutation.info.is_capture && main_buf[i].info.from == refutation.info.to) {
-                            main_scores[i] += 800;
-                        }
-                    }
-                }
+                // Generate quiets in main buffer, and only sort those that are likely to be searched
+                if (!in_check) main_buf_size = gen.gen_quiets(main_buf);
+                score_quiets();
+                partial_insertion_sort(main_buf, main_scores, main_buf_size, -2048 * depth);
             }
         case GEN_QUIETS:
-            // Pick best quiet until there are none left
+            // Try quiets in order until there are none left
             if (!skip_quiets && main_idx < main_buf_size) {
-                int best_main_idx = main_idx;
-                for (int i = main_idx; i < main_buf_size; i++) {
-                    if (main_scores[i] > main_scores[best_main_idx]) {
-                        best_main_idx = i;
-                    }
-                }
-                buf_swap_main(best_main_idx, main_idx);
-
                 if (main_buf[main_idx] == hash_move) {
                     main_idx++;
                     goto retry;
                 }
 
-                else stage = GEN_QUIETS;
                 score = main_scores[main_idx];
                 return main_buf[main_idx++];
             }
             stage = GEN_BAD_NOISY;
         case GEN_BAD_NOISY:
-            // Bad captures are already sorted by MVV
+            // Bad captures keep their order from the good capture stage
             if (bad_capt_idx < bad_capt_buf_size) {
                 if (capt_buf[bad_capt_idx] == hash_move) {
                     bad_capt_idx++;
@@ -130,23 +158,62 @@ move_t movesort_t::next(GenStage &stage, int &score, bool skip_quiets) {
     }
 }
 
-void movesort_t::buf_swap_main(int a, int b) {
-    move_t temp = main_buf[a];
-    main_buf[a] = main_buf[b];
-    main_buf[b] = temp;
-
-    int score = main_scores[a];
-    main_scores[a] = main_scores[b];
-    main_scores[b] = score;
-}
-
-void movesort_t::buf_swap_capt(int a, int b) {
-    move_t temp = capt_buf[a];
-    capt_buf[a] = capt_buf[b];
-    capt_buf[b] = temp;
+void movesort_t::score_quiets() {
+    const Team team = board.record.back().next_move;
+    const bool refuted_capture = refutation != EMPTY_MOVE && board.sq_data[refutation.info.to].occupied;
+    for (int i = 0; i < main_buf_size; i++) {
+        if (main_buf[i] == killer_1) {
+            main_scores[i] = 1000000003;
+        } else if (main_buf[i] == killer_2) {
+            main_scores[i] = 1000000002;
+        } else if (main_buf[i] == killer_3) {
+            main_scores[i] = 1000000001;
+        } else {
+            main_scores[i] = heur.history.get(team, main_buf[i]);
+            if (refuted_capture && main_buf[i].info.from == refutation.info.to) {
+                main_scores[i] += 800;
+            }
+        }
+    }
 }
 
 move_t *movesort_t::generated_quiets(size_t &count) {
     count = main_idx;
     return main_buf;
 }
+
+qmovesort_t::qmovesort_t(const heuristic_set_t &heuristics, const board_t &board, const attack_map_t &attacks) :
+        board(board), attacks(attacks.is_current(board) ? &attacks : nullptr),
+        in_check(this->attacks ? attacks.is_incheck(board) : board.is_incheck()) {
+    movegen_t gen = this->attacks ? movegen_t(board, attacks) : movegen_t(board);
+    buf_size = in_check ? gen.gen_evasions(buf) : gen.gen_noisy(buf);
+    score_noisy(heuristics, board, buf, scores, buf_size);
+
+    // Quiet evasions are ordered by history, after all noisy moves
+    if (in_check) {
+        const Team team = board.record.back().next_move;
+        for (int i = 0; i < buf_size; i++) {
+            if (!board.is_capture(buf[i]) && !is_promotion(buf[i])) {
+                scores[i] = heuristics.history.get(team, buf[i]) - 65536;
+            }
+        }
+    }
+
+    partial_insertion_sort(buf, scores, buf_size, INT32_MIN);
+}
+
+move_t qmovesort_t::next(int &score) {
+    if (in_check) {
+        score = 0;
+        return idx < buf_size ? buf[idx++] : EMPTY_MOVE;
+    }
+
+    // Skip captures which lose material
+    while (idx < buf_size) {
+        move_t move = buf[idx++];
+        score = attacks ? board.see(move, *attacks) : board.see(move);
+        if (score >= 0) return move;
+    }
+
+    return EMPTY_MOVE;
+}
@@ -7,10 +7,6 @@
 
 #include "movegen.h"
 
-enum GenMode {
-    NORMAL, QUIESCENCE
-};
-
 enum GenStage {
     GEN_NONE,
     GEN_HASH,
@@ -22,13 +18,12 @@ enum GenStage {
 // History heuristic
 class history_heur_t {
 public:
-    void update(move_t move, int bonus) {
-        table[move.info.team][move.info.from][move.info.to] +=
-                bonus - table[move.info.team][move.info.from][move.info.to] * abs(bonus) / 16384;
+    void update(Team team, move_t move, int bonus) {
+        table[team][move.info.from][move.info.to] += bonus - table[team][move.info.from][move.info.to] * abs(bonus) / 16384;
     }
 
-    int get(move_t move) const {
-        return table[move.info.team][move.info.from][move.info.to];
+    int get(Team team, move_t move) const {
+        return table[team][move.info.from][move.info.to];
     }
 private:
     // Indexed by [TEAM][FROM][TO]
@@ -38,8 +33,9 @@ private:
 // Killer heuristic
 class killer_heur_t {
 public:
+    // Only quiet moves are killers
     void update(move_t killer, int ply) {
-        if (!killer.info.is_capture && killer != killers[ply][0]) {
+        if (killer != killers[ply][0]) {
             killers[ply][1] = killers[ply][0];
             killers[ply][0] = killer;
         }
@@ -56,28 +52,48 @@ private:
     move_t killers[MAX_PLY][2] = {{}};
 };
 
+// Capture history heuristic
+class capture_history_heur_t {
+public:
+    // The board is the position the move is made from
+    void update(const board_t &board, move_t move, int bonus) {
+        int16_t &entry = table[board.moving_team(move)][board.moving_piece(move)][move.info.to][board.captured_piece(move)];
+        entry += bonus - entry * abs(bonus) / 16384;
+    }
+
+    int get(const board_t &board, move_t move) const {
+        return table[board.moving_team(move)][board.moving_piece(move)][move.info.to][board.captured_piece(move)];
+    }
+private:
+    // Indexed by [TEAM][PIECE][TO][CAPTURED]
+    int16_t table[2][6][64][6] = {};
+};
+
 struct heuristic_set_t {
     history_heur_t history;
+    capture_history_heur_t capture_history;
     killer_heur_t killers;
 };
 
 class movesort_t {
 public:
-    movesort_t(GenMode mode, const heuristic_set_t &heuristics, const board_t &board, move_t hash_move, move_t refutation, int ply);
+    movesort_t(const heuristic_set_t &heuristics, const board_t &board, const attack_map_t &attacks, move_t hash_move, move_t refutation, int ply, int depth);
 
     move_t next(GenStage &stage, int &score, bool skip_quiets);
     move_t *generated_quiets(size_t &count);
 private:
-    GenMode mode;
     const heuristic_set_t &heur;
     const board_t &board;
+    const attack_map_t *attacks; // Attack map of the position if the evaluation has built it, or nullptr
+    bool in_check; // Only evasions are generated in check
     move_t hash_move;
     move_t refutation;
 
+    int depth;
+
     move_t killer_1, killer_2, killer_3;
 
-    void buf_swap_main(int a, int b);
-    void buf_swap_capt(int a, int b);
+    void score_quiets();
 
     movegen_t gen;
 
@@ -91,6 +107,32 @@ private:
     int bad_capt_idx = 0;
     int bad_capt_buf_size = 0;
     move_t capt_buf[64];
+    int capt_scores[64];
+};
+
+/**
+ * Move picker for the quiescence search. It only generates noisy moves, into a buffer small enough for the stack, and
+ * returns those that do not lose material in order of MVV-LVA and capture history. In check it returns every evasion
+ * instead, with captures first.
+ */
+class qmovesort_t {
+public:
+    qmovesort_t(const heuristic_set_t &heuristics, const board_t &board, const attack_map_t &attacks);
+
+    /**
+     * @param score set to the static exchange evaluation of the returned move, or 0 in check
+     * @return the next capture or promotion, or EMPTY_MOVE if there are none left
+     */
+    move_t next(int &score);
+private:
+    const board_t &board;
+    const attack_map_t *attacks; // Attack map of the position if the evaluation has built it, or nullptr
+    bool in_check; // Only evasions are generated in check, and all of them are returned
+
+    int idx = 0;
+    int buf_size = 0;
+    move_t buf[64];
+    int scores[64];
 };
 
 
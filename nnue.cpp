@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "nnue.h"
+
+namespace nnue {
+    namespace {
+        template<typename T>
+        T read_le(std::istream &stream) {
+            unsigned char bytes[sizeof(T)] = {};
+            stream.read(reinterpret_cast<char *>(bytes), sizeof(T));
+
+            std::make_unsigned_t<T> value = 0;
+            for (size_t i = 0; i < sizeof(T); i++) {
+                value |= std::make_unsigned_t<T>(bytes[i]) << (8u * i);
+            }
+            return T(value);
+        }
+
+        template<typename T>
+        void read_le(std::istream &stream, std::vector<T> &values, size_t count) {
+            std::vector<unsigned char> bytes(count * sizeof(T));
+            stream.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+
+            values.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                std::make_unsigned_t<T> value = 0;
+                for (size_t j = 0; j < sizeof(T); j++) {
+                    value |= std::make_unsigned_t<T>(bytes[i * sizeof(T) + j]) << (8u * j);
+                }
+                values[i] = T(value);
+            }
+        }
+
+        /// Scalar kernels, used by the reference implementation and where no vector extension is available
+
+        void transform_scalar(const accumulator_t &acc, Team side, uint8_t *output) {
+            for (Team perspective : {side, Team(!side)}) {
+                const int16_t *input = acc.values[perspective];
+                for (size_t i = 0; i < HALF_DIMENSIONS; i++) {
+                    output[i] = uint8_t(std::clamp<int>(input[i], 0, 127));
+                }
+                output += HALF_DIMENSIONS;
+            }
+        }
+
+        template<size_t IN, size_t OUT>
+        void affine_scalar(const uint8_t *input, const int8_t *weights, const int32_t *biases, int32_t *output) {
+            for (size_t o = 0; o < OUT; o++) {
+                int32_t sum = biases[o];
+                for (size_t i = 0; i < IN; i++) {
+                    sum += input[i] * weights[o * IN + i];
+                }
+                output[o] = sum;
+            }
+        }
+
+        /// Vectorised kernels
+
+        inline void add_weights(int16_t *acc, const int16_t *weights) {
+#if defined(__AVX2__)
+            for (size_t i = 0; i < HALF_DIMENSIONS; i += 16) {
+                __m256i a = _mm256_loadu_si256((const __m256i *) (acc + i));
+                __m256i w = _mm256_loadu_si256((const __m256i *) (weights + i));
+                _mm256_storeu_si256((__m256i *) (acc + i), _mm256_add_epi16(a, w));
+            }
+#elif defined(__SSE2__)
+            for (size_t i = 0; i < HALF_DIMENSIONS; i += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i *) (acc + i));
+                __m128i w = _mm_loadu_si128((const __m128i *) (weights + i));
+                _mm_storeu_si128((__m128i *) (acc + i), _mm_add_epi16(a, w));
+            }
+#else
+            for (size_t i = 0; i < HALF_DIMENSIONS; i++) acc[i] += weights[i];
+#endif
+        }
+
+        inline void sub_weights(int16_t *acc, const int16_t *weights) {
+#if defined(__AVX2__)
+            for (size_t i = 0; i < HALF_DIMENSIONS; i += 16) {
+                __m256i a = _mm256_loadu_si256((const __m256i *) (acc + i));
+                __m256i w = _mm256_loadu_si256((const __m256i *) (weights + i));
+                _mm256_storeu_si256((__m256i *) (acc + i), _mm256_sub_epi16(a, w));
+            }
+#elif defined(__SSE2__)
+            for (size_t i = 0; i < HALF_DIMENSIONS; i += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i *) (acc + i));
+                __m128i w = _mm_loadu_si128((const __m128i *) (weights + i));
+                _mm_storeu_si128((__m128i *) (acc + i), _mm_sub_epi16(a, w));
+            }
+#else
+            for (size_t i = 0; i < HALF_DIMENSIONS; i++) acc[i] -= weights[i];
+#endif
+        }
+
+        // Clamp both perspectives of the accumulator to [0, 127], side to move first
+        inline void transform(const accumulator_t &acc, Team side, uint8_t *output) {
+#if defined(__AVX2__)
+            const __m256i zero = _mm256_setzero_si256();
+            for (Team perspective : {side, Team(!side)}) {
+                const int16_t *input = acc.values[perspective];
+                for (size_t i = 0; i < HALF_DIMENSIONS; i += 32) {
+                    __m256i a = _mm256_max_epi16(_mm256_loadu_si256((const __m256i *) (input + i)), zero);
+                    __m256i b = _mm256_max_epi16(_mm256_loadu_si256((const __m256i *) (input + i + 16)), zero);
+                    // Packing works within 128 bit lanes, so put the quadwords back in order
+                    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+                    _mm256_storeu_si256((__m256i *) (output + i), packed);
+                }
+                output += HALF_DIMENSIONS;
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            for (Team perspective : {side, Team(!side)}) {
+                const int16_t *input = acc.values[perspective];
+                for (size_t i = 0; i < HALF_DIMENSIONS; i += 16) {
+                    __m128i a = _mm_max_epi16(_mm_loadu_si128((const __m128i *) (input + i)), zero);
+                    __m128i b = _mm_max_epi16(_mm_loadu_si128((const __m128i *) (input + i + 8)), zero);
+                    _mm_storeu_si128((__m128i *) (output + i), _mm_packs_epi16(a, b));
+                }
+                output += HALF_DIMENSIONS;
+            }
+#else
+            transform_scalar(acc, side, output);
+#endif
+        }
+
+        template<size_t IN, size_t OUT>
+        inline void affine(const uint8_t *input, const int8_t *weights, const int32_t *biases, int32_t *output) {
+#if defined(__AVX2__)
+            static_assert(IN % 32 == 0);
+            const __m256i ones = _mm256_set1_epi16(1);
+            for (size_t o = 0; o < OUT; o++) {
+                __m256i sum = _mm256_setzero_si256();
+                for (size_t i = 0; i < IN; i += 32) {
+                    __m256i in = _mm256_loadu_si256((const __m256i *) (input + i));
+                    __m256i w = _mm256_loadu_si256((const __m256i *) (weights + o * IN + i));
+                    // Inputs are at most 127, so the pairwise sums cannot saturate
+                    __m256i product = _mm256_maddubs_epi16(in, w);
+                    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(product, ones));
+                }
+
+                __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+                total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+                total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+                output[o] = biases[o] + _mm_cvtsi128_si32(total);
+            }
+#elif defined(__SSE2__)
+            static_assert(IN % 16 == 0);
+            const __m128i zero = _mm_setzero_si128();
+            for (size_t o = 0; o < OUT; o++) {
+                __m128i sum = _mm_setzero_si128();
+                for (size_t i = 0; i < IN; i += 16) {
+                    __m128i in = _mm_loadu_si128((const __m128i *) (input + i));
+                    __m128i w = _mm_loadu_si128((const __m128i *) (weights + o * IN + i));
+                    // Widen to 16 bits: inputs are unsigned, weights are signed
+                    __m128i sign = _mm_cmpgt_epi8(zero, w);
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(in, zero), _mm_unpacklo_epi8(w, sign)));
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(in, zero), _mm_unpackhi_epi8(w, sign)));
+                }
+
+                sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+                sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+                output[o] = biases[o] + _mm_cvtsi128_si32(sum);
+            }
+#else
+            affine_scalar<IN, OUT>(input, weights, biases, output);
+#endif
+        }
+
+        template<size_t N>
+        inline void clipped_relu(const int32_t *input, uint8_t *output) {
+            for (size_t i = 0; i < N; i++) {
+                output[i] = uint8_t(std::clamp(input[i] >> WEIGHT_SCALE_BITS, 0, 127));
+            }
+        }
+
+        inline bool moves_king(const dirty_pieces_t &dirty, Team side) {
+            for (uint8_t i = 0; i < dirty.count; i++) {
+                if (dirty.changes[i].piece == KING && dirty.changes[i].team == side) return true;
+            }
+            return false;
+        }
+    }
+
+    network_t::network_t(const std::string &path) {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) throw std::runtime_error("cannot open network " + path);
+
+        if (read_le<uint32_t>(stream) != VERSION) {
+            throw std::runtime_error(path + " is not a supported network");
+        }
+        read_le<uint32_t>(stream); // Network hash
+
+        auto description_size = read_le<uint32_t>(stream);
+        if (!stream || description_size > 4096) throw std::runtime_error("invalid network header in " + path);
+        description.resize(description_size);
+        stream.read(description.data(), description_size);
+
+        read_le<uint32_t>(stream); // Feature transformer hash
+        read_le(stream, ft_biases, HALF_DIMENSIONS);
+        read_le(stream, ft_weights, INPUT_DIMENSIONS * HALF_DIMENSIONS);
+
+        read_le<uint32_t>(stream); // Layers hash
+        read_le(stream, l1_biases, L2);
+        read_le(stream, l1_weights, L2 * L1);
+        read_le(stream, l2_biases, L3);
+        read_le(stream, l2_weights, L3 * L2);
+        read_le(stream, out_biases, 1);
+        read_le(stream, out_weights, L3);
+
+        if (!stream || stream.peek() != std::ifstream::traits_type::eof()) {
+            throw std::runtime_error("unexpected network size in " + path);
+        }
+    }
+
+    int network_t::evaluate(const board_t &board, accumulator_stack_t &stack) const {
+        update(board, stack);
+        int output = propagate(stack[board.record.size() - 1], board.record.back().next_move);
+        return output * 100 / PAWN_VALUE;
+    }
+
+    void network_t::update(const board_t &board, accumulator_stack_t &stack) const {
+        const size_t current = board.record.size() - 1;
+        if (stack.size() <= current) stack.resize(current + 1);
+
+        for (Team side : {WHITE, BLACK}) {
+            if (stack[current].key[side] == board.record[current].hash) continue;
+
+            // Find the closest earlier accumulator which only differs by non-king moves of this perspective
+            size_t start = current;
+            bool found = false;
+            while (start > 0) {
+                const dirty_pieces_t &dirty = board.record[start].dirty;
+                if (dirty.count > dirty_pieces_t::MAX_CHANGES || moves_king(dirty, side)) break;
+
+                start--;
+                if (stack[start].key[side] == board.record[start].hash) {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (found) {
+                uint8_t king_sq = bit_scan(board.bb_pieces[side][KING]);
+                for (size_t i = start + 1; i <= current; i++) {
+                    apply(stack[i - 1], stack[i], side, king_sq, board.record[i]);
+                }
+            } else {
+                refresh(board, stack[current], side);
+            }
+        }
+    }
+
+    void network_t::refresh(const board_t &board, accumulator_t &acc, Team side) const {
+        int16_t *values = acc.values[side];
+        std::memcpy(values, ft_biases.data(), sizeof(acc.values[side]));
+
+        uint8_t king_sq = bit_scan(board.bb_pieces[side][KING]);
+        for (Team team : {WHITE, BLACK}) {
+            for (uint8_t piece = PAWN; piece < KING; piece++) {
+                U64 bb = board.bb_pieces[team][piece];
+                while (bb) {
+                    size_t index = feature_index(side, king_sq, team, Piece(piece), pop_bit(bb));
+                    add_weights(values, ft_weights.data() + index * HALF_DIMENSIONS);
+                }
+            }
+        }
+
+        acc.key[side] = board.record.back().hash;
+    }
+
+    void network_t::apply(const accumulator_t &prev, accumulator_t &acc, Team side, uint8_t king_sq,
+                          const game_record_t &record) const {
+        int16_t *values = acc.values[side];
+        std::memcpy(values, prev.values[side], sizeof(acc.values[side]));
+
+        for (uint8_t i = 0; i < record.dirty.count; i++) {
+            const dirty_pieces_t::change_t &change = record.dirty.changes[i];
+            if (change.piece == KING) continue; // Kings are not inputs
+
+            size_t index = feature_index(side, king_sq, change.team, change.piece, change.square);
+            if (change.added) {
+                add_weights(values, ft_weights.data() + index * HALF_DIMENSIONS);
+            } else {
+                sub_weights(values, ft_weights.data() + index * HALF_DIMENSIONS);
+            }
+        }
+
+        acc.key[side] = record.hash;
+    }
+
+    int network_t::propagate(const accumulator_t &acc, Team side) const {
+        alignas(64) uint8_t transformed[L1];
+        alignas(64) int32_t l1_out[L2];
+        alignas(64) uint8_t l1_act[L2];
+        alignas(64) int32_t l2_out[L3];
+        alignas(64) uint8_t l2_act[L3];
+        int32_t output;
+
+        transform(acc, side, transformed);
+        affine<L1, L2>(transformed, l1_weights.data(), l1_biases.data(), l1_out);
+        clipped_relu<L2>(l1_out, l1_act);
+        affine<L2, L3>(l1_act, l2_weights.data(), l2_biases.data(), l2_out);
+        clipped_relu<L3>(l2_out, l2_act);
+        affine<L3, 1>(l2_act, out_weights.data(), out_biases.data(), &output);
+
+        return output / OUTPUT_SCALE;
+    }
+
+    int network_t::propagate_reference(const accumulator_t &acc, Team side) const {
+        uint8_t transformed[L1];
+        int32_t l1_out[L2];
+        uint8_t l1_act[L2];
+        int32_t l2_out[L3];
+        uint8_t l2_act[L3];
+        int32_t output;
+
+        transform_scalar(acc, side, transformed);
+        affine_scalar<L1, L2>(transformed, l1_weights.data(), l1_biases.data(), l1_out);
+        clipped_relu<L2>(l1_out, l1_act);
+        affine_scalar<L2, L3>(l1_act, l2_weights.data(), l2_biases.data(), l2_out);
+        clipped_relu<L3>(l2_out, l2_act);
+        affine_scalar<L3, 1>(l2_act, out_weights.data(), out_biases.data(), &output);
+
+        return output / OUTPUT_SCALE;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef TOPPLE_NNUE_H
+#define TOPPLE_NNUE_H
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "board.h"
+
+/**
+ * Efficiently updatable neural network evaluation, using HalfKP inputs and the 256x2-32-32-1 network format.
+ *
+ * The first layer (the feature transformer) is kept in an accumulator for each position in the game record. It is
+ * updated from the pieces switched by each move, and only recomputed from scratch when a king moves.
+ */
+namespace nnue {
+    constexpr uint32_t VERSION = 0x7AF32F16u;
+
+    constexpr size_t HALF_DIMENSIONS = 256;
+    constexpr size_t PS_END = 10 * 64 + 1; // Piece-square inputs for each king square
+    constexpr size_t INPUT_DIMENSIONS = 64 * PS_END;
+
+    constexpr size_t L1 = 2 * HALF_DIMENSIONS;
+    constexpr size_t L2 = 32;
+    constexpr size_t L3 = 32;
+
+    constexpr int WEIGHT_SCALE_BITS = 6;
+    constexpr int OUTPUT_SCALE = 16;
+    constexpr int PAWN_VALUE = 208; // Scaled network output for one pawn
+
+    /**
+     * First layer outputs for both perspectives, with the hash of the position each perspective was computed for
+     */
+    struct alignas(64) accumulator_t {
+        int16_t values[2][HALF_DIMENSIONS];
+        U64 key[2] = {~U64(0), ~U64(0)};
+    };
+
+    /**
+     * Accumulators, indexed by position in the game record
+     */
+    typedef std::vector<accumulator_t> accumulator_stack_t;
+
+    /**
+     * Input index of a non-king piece, from the perspective of {@code side} with its king on {@code king_sq}
+     */
+    inline size_t feature_index(Team side, uint8_t king_sq, Team team, Piece piece, uint8_t sq) {
+        uint8_t orient = side == WHITE ? 0 : 63;
+        return (sq ^ orient) + 1 + (piece * 2 + (team != side)) * 64 + PS_END * (king_sq ^ orient);
+    }
+
+    class network_t {
+    public:
+        /**
+         * Load a network
+         *
+         * @param path file name
+         * @throws std::runtime_error if the file cannot be read or is not a network in the supported format
+         */
+        explicit network_t(const std::string &path);
+
+        network_t(const network_t &) = delete;
+
+        /**
+         * Evaluate a position, updating the accumulators on the way
+         *
+         * @param board position
+         * @param stack accumulators of the positions in the game record
+         * @return evaluation in centipawns, relative to the side to move
+         */
+        int evaluate(const board_t &board, accumulator_stack_t &stack) const;
+
+        /**
+         * Bring the accumulator of the current position up to date, from an earlier accumulator if possible
+         */
+        void update(const board_t &board, accumulator_stack_t &stack) const;
+
+        /**
+         * Compute the accumulator of a perspective from scratch
+         */
+        void refresh(const board_t &board, accumulator_t &acc, Team side) const;
+
+        /**
+         * Run the layers after the feature transformer, relative to {@code side}. The reference implementation is
+         * plain scalar code, used to check the vectorised kernels.
+         */
+        int propagate(const accumulator_t &acc, Team side) const;
+        int propagate_reference(const accumulator_t &acc, Team side) const;
+
+        const std::string &get_description() const {
+            return description;
+        }
+    private:
+        void apply(const accumulator_t &prev, accumulator_t &acc, Team side, uint8_t king_sq,
+                   const game_record_t &record) const;
+
+        std::string description;
+
+        std::vector<int16_t> ft_biases;
+        std::vector<int16_t> ft_weights; // [INPUT_DIMENSIONS][HALF_DIMENSIONS]
+
+        std::vector<int32_t> l1_biases;
+        std::vector<int8_t> l1_weights; // [L2][L1]
+        std::vector<int32_t> l2_biases;
+        std::vector<int8_t> l2_weights; // [L3][L2]
+        std::vector<int32_t> out_biases;
+        std::vector<int8_t> out_weights; // [1][L3]
+    };
+}
+
+#endif //TOPPLE_NNUE_H
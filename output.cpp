@@ -0,0 +1,126 @@
+#include <iostream>
+
+#include "output.h"
+
+namespace output {
+    namespace {
+        // Batches from writers sharing a stream are written one at a time
+        std::mutex stream_mtx;
+    }
+
+    writer_t::writer_t(std::ostream &stream, std::string prefix) : stream(stream), prefix(std::move(prefix)) {
+        thread = std::thread(&writer_t::run, this);
+    }
+
+    writer_t::~writer_t() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            terminated = true;
+        }
+        cv.notify_one();
+        thread.join();
+    }
+
+    void writer_t::write(std::string line) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(std::move(line));
+        }
+        cv.notify_one();
+    }
+
+    void writer_t::write_now(std::string line) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            // Keep held back info lines ahead of this line
+            if (!pending_info.empty()) {
+                queue.push_back(std::move(pending_info));
+                pending_info.clear();
+                last_info = engine_clock::now();
+            }
+
+            queue.push_back(std::move(line));
+            flush_requested = true;
+        }
+        cv.notify_one();
+    }
+
+    void writer_t::info(std::string line) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto now = engine_clock::now();
+            if (now - last_info >= interval) {
+                queue.push_back(std::move(line));
+                pending_info.clear();
+                last_info = now;
+            } else {
+                pending_info = std::move(line);
+            }
+        }
+        cv.notify_one();
+    }
+
+    void writer_t::currmove(std::string line) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto now = engine_clock::now();
+            if (now - last_currmove < interval) return;
+
+            queue.push_back(std::move(line));
+            last_currmove = now;
+        }
+        cv.notify_one();
+    }
+
+    void writer_t::set_interval(int ms) {
+        std::lock_guard<std::mutex> lock(mtx);
+        interval = std::chrono::milliseconds(ms);
+    }
+
+    void writer_t::run() {
+        std::vector<std::string> batch;
+        std::unique_lock<std::mutex> lock(mtx);
+
+        while (true) {
+            cv.wait(lock, [this] { return terminated || !queue.empty() || !pending_info.empty(); });
+
+            // Let more lines join the batch until the deadline, or until a held back info line is due
+            auto deadline = queue.empty() ? last_info + interval : engine_clock::now() + FLUSH_DEADLINE;
+            cv.wait_until(lock, deadline, [this] { return terminated || flush_requested; });
+
+            if (!pending_info.empty() && (terminated || engine_clock::now() - last_info >= interval)) {
+                queue.push_back(std::move(pending_info));
+                pending_info.clear();
+                last_info = engine_clock::now();
+            }
+
+            batch.swap(queue);
+            flush_requested = false;
+            bool done = terminated && pending_info.empty();
+
+            // Write without holding the lock, so that the search never waits on I/O
+            lock.unlock();
+            std::string buf;
+            for (const auto &line : batch) {
+                buf += prefix;
+                buf += line;
+                buf += '\n';
+            }
+            if (!buf.empty()) {
+                std::lock_guard<std::mutex> stream_lock(stream_mtx);
+                stream << buf;
+                stream.flush();
+            }
+            batch.clear();
+            lock.lock();
+
+            if (done && queue.empty()) break;
+        }
+    }
+
+    writer_t &uci() {
+        static writer_t writer(std::cout);
+        return writer;
+    }
+}
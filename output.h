@@ -0,0 +1,82 @@
+#ifndef TOPPLE_OUTPUT_H
+#define TOPPLE_OUTPUT_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+
+namespace output {
+    /**
+     * Buffered line writer. Lines are queued by the caller and written in batches by a dedicated I/O thread, so that
+     * the search never waits on a flush.
+     */
+    class writer_t {
+        // Queued lines are written no later than this after they are queued
+        static constexpr std::chrono::milliseconds FLUSH_DEADLINE = std::chrono::milliseconds(10);
+    public:
+        /**
+         * @param stream stream to write to, which may be shared with other writers
+         * @param prefix written before every line, to tell apart the output of writers sharing a stream
+         */
+        explicit writer_t(std::ostream &stream, std::string prefix = "");
+        ~writer_t();
+        writer_t(const writer_t &) = delete;
+
+        /**
+         * Queue a line, to be written within the flush deadline.
+         */
+        void write(std::string line);
+
+        /**
+         * Queue a line and flush it immediately, along with everything queued before it.
+         */
+        void write_now(std::string line);
+
+        /**
+         * Queue a search info line. If the previous info line was written less than the info interval ago, the line is
+         * held back, and replaced by any newer info line, until the interval has passed.
+         */
+        void info(std::string line);
+
+        /**
+         * Queue a currmove line. The line is dropped if the previous one was written less than the info interval ago.
+         */
+        void currmove(std::string line);
+
+        /**
+         * Set the minimum interval between info lines, and between currmove lines. Zero disables rate limiting.
+         */
+        void set_interval(int ms);
+    private:
+        void run();
+
+        std::ostream &stream;
+        std::string prefix;
+
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<std::string> queue;
+        std::string pending_info;
+        bool flush_requested = false;
+        bool terminated = false;
+
+        // Rate limiting
+        std::chrono::milliseconds interval = std::chrono::milliseconds(0);
+        engine_clock::time_point last_info;
+        engine_clock::time_point last_currmove;
+
+        std::thread thread;
+    };
+
+    /**
+     * Writer for UCI output on stdout. The I/O thread is started on first use.
+     */
+    writer_t &uci();
+}
+
+#endif //TOPPLE_OUTPUT_H
@@ -5,10 +5,9 @@
 #include "pawns.h"
 #include "eval.h"
 
-pawns::structure_t::structure_t(const processed_params_t &params, U64 kp_hash, U64 w_pawns, U64 b_pawns, U64 w_king,
-                                U64 b_king)
-        : hash(kp_hash) {
-    v4si_t score = {0, 0, 0, 0};
+pawns::structure_t::structure_t(const processed_params_t &params, U64 pawn_hash, U64 w_pawns, U64 b_pawns)
+        : hash(pawn_hash) {
+    v4hi_t score = {0, 0, 0, 0};
     
     // Find pawns
     U64 open[2] = {pawns::open_pawns<WHITE>(w_pawns, b_pawns), pawns::open_pawns<BLACK>(b_pawns, w_pawns)};
@@ -50,48 +49,37 @@ pawns::structure_t::structure_t(const processed_params_t &params, U64 kp_hash, U
     }; // [TEAM][OPEN]
 
     // Add to the scores
-    score += (isolated_counts[WHITE][0] - isolated_counts[BLACK][0]) * params.isolated[0];
-    score += (isolated_counts[WHITE][1] - isolated_counts[BLACK][1]) * params.isolated[1];
+    score += int16_t(isolated_counts[WHITE][0] - isolated_counts[BLACK][0]) * params.isolated[0];
+    score += int16_t(isolated_counts[WHITE][1] - isolated_counts[BLACK][1]) * params.isolated[1];
 
-    score += (backwards_counts[WHITE][0] - backwards_counts[BLACK][0]) * params.backwards[0];
-    score += (backwards_counts[WHITE][1] - backwards_counts[BLACK][1]) * params.backwards[1];
+    score += int16_t(backwards_counts[WHITE][0] - backwards_counts[BLACK][0]) * params.backwards[0];
+    score += int16_t(backwards_counts[WHITE][1] - backwards_counts[BLACK][1]) * params.backwards[1];
 
-    score += (semi_backwards_counts[WHITE][0] - semi_backwards_counts[BLACK][0]) * params.semi_backwards[0];
-    score += (semi_backwards_counts[WHITE][1] - semi_backwards_counts[BLACK][1]) * params.semi_backwards[1];
+    score += int16_t(semi_backwards_counts[WHITE][0] - semi_backwards_counts[BLACK][0]) * params.semi_backwards[0];
+    score += int16_t(semi_backwards_counts[WHITE][1] - semi_backwards_counts[BLACK][1]) * params.semi_backwards[1];
 
-    score += (paired_counts[WHITE][0] - paired_counts[BLACK][0]) * params.paired[0];
-    score += (paired_counts[WHITE][1] - paired_counts[BLACK][1]) * params.paired[1];
+    score += int16_t(paired_counts[WHITE][0] - paired_counts[BLACK][0]) * params.paired[0];
+    score += int16_t(paired_counts[WHITE][1] - paired_counts[BLACK][1]) * params.paired[1];
 
-    score += (detached_counts[WHITE][0] - detached_counts[BLACK][0]) * params.detached[0];
-    score += (detached_counts[WHITE][1] - detached_counts[BLACK][1]) * params.detached[1];
+    score += int16_t(detached_counts[WHITE][0] - detached_counts[BLACK][0]) * params.detached[0];
+    score += int16_t(detached_counts[WHITE][1] - detached_counts[BLACK][1]) * params.detached[1];
 
-    score += (doubled_counts[WHITE][0] - doubled_counts[BLACK][0]) * params.doubled[0];
-    score += (doubled_counts[WHITE][1] - doubled_counts[BLACK][1]) * params.doubled[1];
+    score += int16_t(doubled_counts[WHITE][0] - doubled_counts[BLACK][0]) * params.doubled[0];
+    score += int16_t(doubled_counts[WHITE][1] - doubled_counts[BLACK][1]) * params.doubled[1];
 
     U64 bb;
 
-    // King PST
-    int king_loc[2] = {bit_scan(w_king), bit_scan(b_king)};
-    score += params.pst[WHITE][KING][king_loc[WHITE]];
-    score -= params.pst[BLACK][KING][king_loc[BLACK]];
-
     // Pawn PST
     bb = w_pawns;
     while (bb) {
         uint8_t sq = pop_bit(bb);
         score += params.pst[WHITE][PAWN][sq];
-
-        score += distance(king_loc[WHITE], sq) * params.king_tropism[0];
-        score += distance(king_loc[BLACK], sq) * params.king_tropism[1];
     }
 
     bb = b_pawns;
     while (bb) {
         uint8_t sq = pop_bit(bb);
         score -= params.pst[BLACK][PAWN][sq];
-
-        score -= distance(king_loc[BLACK], sq) * params.king_tropism[0];
-        score -= distance(king_loc[WHITE], sq) * params.king_tropism[1];
     }
 
     // Chain
@@ -115,9 +103,6 @@ pawns::structure_t::structure_t(const processed_params_t &params, U64 kp_hash, U
         uint8_t sq = pop_bit(bb);
         uint8_t rank = rel_rank(WHITE, rank_index(sq));
         score += params.passed[rank - 1];
-
-        score += distance(king_loc[WHITE], sq) * params.passer_tropism[0];
-        score += distance(king_loc[BLACK], sq) * params.passer_tropism[1];
     }
 
     bb = passed[BLACK];
@@ -125,9 +110,6 @@ pawns::structure_t::structure_t(const processed_params_t &params, U64 kp_hash, U
         uint8_t sq = pop_bit(bb);
         uint8_t rank = rel_rank(BLACK, rank_index(sq));
         score -= params.passed[rank - 1];
-
-        score -= distance(king_loc[BLACK], sq) * params.passer_tropism[0];
-        score -= distance(king_loc[WHITE], sq) * params.passer_tropism[1];
     }
 
     // Candidates
@@ -158,8 +140,65 @@ pawns::structure_t::structure_t(const processed_params_t &params, U64 kp_hash, U
         }
     }
 
-    this->taper = (float) std::clamp(accumulator, 0, params.pt_max) / (float) params.pt_max;
+    this->taper = std::clamp(accumulator, 0, params.pt_max) * TAPER_SCALE / params.pt_max;
+
+    this->eval_mg = (taper * score[0] + (TAPER_SCALE - taper) * score[1]) / TAPER_SCALE;
+    this->eval_eg = (taper * score[2] + (TAPER_SCALE - taper) * score[3]) / TAPER_SCALE;
+
+    // Bitboards for the rest of the evaluation
+    this->passed[WHITE] = passed[WHITE];
+    this->passed[BLACK] = passed[BLACK];
+    this->attacks[WHITE] = pawns::attacks<WHITE>(w_pawns);
+    this->attacks[BLACK] = pawns::attacks<BLACK>(b_pawns);
+    this->holes[WHITE] = pawns::holes<WHITE>(w_pawns);
+    this->holes[BLACK] = pawns::holes<BLACK>(b_pawns);
+    this->open_files = pawns::open_files(w_pawns, b_pawns);
+    this->half_open_files[WHITE] = pawns::half_or_open_files(w_pawns) ^ open_files;
+    this->half_open_files[BLACK] = pawns::half_or_open_files(b_pawns) ^ open_files;
+}
+
+pawns::king_shelter_t::king_shelter_t(const processed_params_t &params, U64 key, Team team, uint8_t king_sq,
+                                      U64 king_circle, U64 pawn_shield, U64 own_pawns, U64 other_pawns,
+                                      const structure_t &structure) : hash(key) {
+    auto x_team = Team(!team);
+
+    // King PST
+    score += params.pst[team][KING][king_sq];
+
+    // Tropism
+    U64 bb = own_pawns;
+    while (bb) {
+        score += int16_t(distance(king_sq, pop_bit(bb))) * params.king_tropism[0];
+    }
+
+    bb = other_pawns;
+    while (bb) {
+        score -= int16_t(distance(king_sq, pop_bit(bb))) * params.king_tropism[1];
+    }
+
+    bb = structure.get_passed(team);
+    while (bb) {
+        score += int16_t(distance(king_sq, pop_bit(bb))) * params.passer_tropism[0];
+    }
 
-    this->eval_mg = taper * score[0] + (1 - taper) * score[1];
-    this->eval_eg = taper * score[2] + (1 - taper) * score[3];
+    bb = structure.get_passed(x_team);
+    while (bb) {
+        score -= int16_t(distance(king_sq, pop_bit(bb))) * params.passer_tropism[1];
+    }
+
+    // Pawn shield
+    int shield = std::min(3, pop_count(pawn_shield & own_pawns));
+    score += params.ks_pawn_shield[shield];
+
+    pawn_danger = params.kat_attack_weight[PAWN] * pop_count(structure.get_attacks(x_team) & king_circle)
+                  - params.kat_defence_weight[PAWN] * shield;
+
+    // Open files
+    if (king_circle & structure.get_open_files()) {
+        file_danger = params.kat_open_file;
+    } else if (king_circle & structure.get_half_open_files(team)) {
+        file_danger = params.kat_own_half_open_file;
+    } else if (king_circle & structure.get_half_open_files(x_team)) {
+        file_danger = params.kat_other_half_open_file;
+    }
 }
\ No newline at end of file
@@ -198,36 +198,96 @@ namespace pawns {
         return own & stop_squares<Team(!team)>(other);
     }
 
-    // Represents a pawn structure
+    // Represents a pawn structure, and the bitboards derived from it that the rest of the evaluation uses
     class structure_t {
     public:
         structure_t() = default;
-        structure_t(const processed_params_t &params, U64 kp_hash, U64 w_pawns, U64 b_pawns, U64 w_king, U64 b_king);
+        structure_t(const processed_params_t &params, U64 pawn_hash, U64 w_pawns, U64 b_pawns);
 
         inline U64 get_hash() const {
             return hash;
         }
 
-        inline int32_t get_eval_mg() const {
+        inline int16_t get_eval_mg() const {
             return eval_mg;
         }
 
-        inline int32_t get_eval_eg() const {
+        inline int16_t get_eval_eg() const {
             return eval_eg;
         }
 
-        inline float get_taper() const {
+        // Pawn structure phase, out of TAPER_SCALE
+        inline int get_taper() const {
             return taper;
         }
+
+        inline U64 get_passed(Team team) const {
+            return passed[team];
+        }
+
+        inline U64 get_attacks(Team team) const {
+            return attacks[team];
+        }
+
+        inline U64 get_holes(Team team) const {
+            return holes[team];
+        }
+
+        inline U64 get_open_files() const {
+            return open_files;
+        }
+
+        inline U64 get_half_open_files(Team team) const {
+            return half_open_files[team];
+        }
     private:
         U64 hash = 0;
 
+        U64 passed[2] = {};
+        U64 attacks[2] = {};
+        U64 holes[2] = {};
+        U64 open_files = 0;
+        U64 half_open_files[2] = {}; // Files without pawns of one side, excluding open files
+
         int16_t eval_mg = 0;
         int16_t eval_eg = 0;
-        float taper = 0;
+        int16_t taper = 0;
+    };
+
+    static_assert(sizeof(structure_t) == 88);
+
+    // Placement of one king relative to the pawns: king PST, tropism to pawns and passed pawns, pawn shield, and king
+    // danger from enemy pawns and open files. Scores are relative to the king's side and are not tapered.
+    class king_shelter_t {
+    public:
+        king_shelter_t() = default;
+        king_shelter_t(const processed_params_t &params, U64 key, Team team, uint8_t king_sq, U64 king_circle,
+                       U64 pawn_shield, U64 own_pawns, U64 other_pawns, const structure_t &structure);
+
+        inline U64 get_hash() const {
+            return hash;
+        }
+
+        inline v4hi_t get_score() const {
+            return score;
+        }
+
+        inline int get_pawn_danger() const {
+            return pawn_danger;
+        }
+
+        inline int get_file_danger() const {
+            return file_danger;
+        }
+    private:
+        v4hi_t score = {};
+        U64 hash = 0;
+
+        int16_t pawn_danger = 0; // King danger from the pawn shield and enemy pawn attacks
+        int16_t file_danger = 0; // King danger from open files, if the enemy has rooks or queens
     };
 
-    static_assert(sizeof(structure_t) == 16);
+    static_assert(sizeof(king_shelter_t) == 24);
 }
 
 
@@ -7,6 +7,23 @@
 #include "syzygy/tbprobe.h"
 
 namespace pvs {
+    void context_t::poll_nodes(std::atomic_bool &aborted) {
+        U64 delta = nodes - polled_nodes;
+        U64 total = shared_nodes ? shared_nodes->fetch_add(delta) + delta : nodes;
+        polled_nodes = nodes;
+
+        if (total < node_limit) {
+            // Poll again exactly when the budget would run out, if that comes first
+            next_poll = nodes + std::min(NODE_POLL_INTERVAL, node_limit - total);
+        } else if (main_pv_saved ? main_pv_saved->load() : !saved_pv.empty()) {
+            aborted = true;
+            next_poll = UINT64_MAX;
+        } else {
+            // Never abort before the main thread has a move to play
+            next_poll = nodes + NODE_POLL_INTERVAL;
+        }
+    }
+
     struct pv_move_t {
         move_t move;
         int move_number;
@@ -20,16 +37,18 @@ namespace pvs {
     int context_t::search_root(std::vector<move_t> root_moves,
                                const std::function<void(int)> &output_info,
                                const std::function<void(int, move_t)> &output_currmove,
-                               int alpha, int beta, int depth, const std::atomic_bool &aborted) {
-        nodes++;
+                               int alpha, int beta, int depth, std::atomic_bool &aborted) {
+        count_node(aborted);
         pv_table_len[0] = 0;
 
+        stack[0].may_repeat = board->upcoming_repetition() != 0;
+
         // Search variables
         int score, best_score = -INF;
         const int old_alpha = alpha;
         move_t best_move{};
 
-        bool in_check = board->is_incheck();
+        bool in_check = is_incheck(0);
 
         // Probe transposition table
         tt::entry_t h = {};
@@ -38,9 +57,9 @@ namespace pvs {
         if (tt->probe(board->record.back().hash, h)) {
             stack[0].eval = h.info.static_eval;
             h_bound = h.bound();
-            tt_move = board->to_move(h.info.move);
+            tt_move = h.info.move;
         } else {
-            stack[0].eval = evaluator->evaluate(*board);
+            stack[0].eval = evaluator->evaluate(*board, stack[0].attacks);
         }
 
         std::vector<pv_move_t> move_list;
@@ -50,7 +69,7 @@ namespace pvs {
 
         // Generate, sort, and determine search parameters
         int n_legal = 0;
-        movesort_t gen(NORMAL, heur, *board, tt_move, EMPTY_MOVE, 0);
+        movesort_t gen(heur, *board, stack[0].attacks, tt_move, EMPTY_MOVE, 0, depth);
         for (move_t move = gen.next(stage, move_score, false);
              move != EMPTY_MOVE; move = gen.next(stage, move_score, false)) {
             if (std::find(root_moves.begin(), root_moves.end(), move) != root_moves.end() && board->is_legal(move)) {
@@ -89,9 +108,11 @@ namespace pvs {
                     if (score >= beta) {
                         tt->save(tt::LOWER, board->record.back().hash, depth, 0, stack[0].eval, score, best_move);
 
-                        if (!move_list[0].move.info.is_capture) {
-                            heur.history.update(move_list[0].move, depth * depth);
+                        if (!board->is_capture(move_list[0].move)) {
+                            heur.history.update(board->record.back().next_move, move_list[0].move, depth * depth);
                             heur.killers.update(move_list[0].move, 0);
+                        } else {
+                            heur.capture_history.update(*board, move_list[0].move, depth * depth);
                         }
 
                         return beta; // Fail hard
@@ -149,7 +170,8 @@ namespace pvs {
 
         if (alpha > old_alpha) {
             tt->save(tt::EXACT, board->record.back().hash, depth, 0, stack[0].eval, alpha, best_move);
-            if (!best_move.info.is_capture) heur.history.update(best_move, depth * depth);
+            if (!board->is_capture(best_move)) heur.history.update(board->record.back().next_move, best_move, depth * depth);
+            else heur.capture_history.update(*board, best_move, depth * depth);
         } else {
             tt->save(tt::UPPER, board->record.back().hash, depth, 0, stack[0].eval, alpha, best_move);
         }
@@ -157,7 +179,7 @@ namespace pvs {
         return alpha;
     }
 
-    int context_t::search_pv(int alpha, int beta, const int ply, const int depth, const std::atomic_bool &aborted) {
+    int context_t::search_pv(int alpha, int beta, const int ply, const int depth, std::atomic_bool &aborted) {
         pv_table_len[ply] = ply;
 
         if (aborted) {
@@ -170,16 +192,25 @@ namespace pvs {
         if (depth < 1) return search_qs<true>(alpha, beta, ply, aborted);
 
         // Count node if we didn't go into quiescence search
-        nodes++;
+        count_node(aborted);
+
+        // A draw is available if a move can repeat a position within the search
+        int repetition = board->upcoming_repetition();
+        stack[ply].may_repeat = repetition != 0;
+        if (repetition && repetition < ply && alpha < 0) {
+            alpha = 0;
+            if (alpha >= beta) return alpha;
+        }
 
         // Search variables
         int score, best_score = -INF;
         const int old_alpha = alpha;
         move_t best_move{};
 
-        // Game state
+        // Game state, only scanning for repetitions if the last move could have repeated a position
         if (board->record.back().halfmove_clock >= 100
-            || board->is_repetition_draw(ply)
+            || ((stack[ply - 1].may_repeat || board->record.back().prev_move == EMPTY_MOVE)
+                && board->is_repetition_draw(ply))
             || board->is_material_draw()) {
             return 0;
         }
@@ -191,12 +222,12 @@ namespace pvs {
         if (tt->probe(board->record.back().hash, h)) {
             stack[ply].eval = h.info.static_eval;
             h_bound = h.bound();
-            tt_move = board->to_move(h.info.move);
+            tt_move = h.info.move;
         } else {
-            stack[ply].eval = evaluator->evaluate(*board);
+            stack[ply].eval = evaluator->evaluate(*board, stack[ply].attacks);
         }
 
-        bool in_check = board->is_incheck();
+        bool in_check = is_incheck(ply);
         bool improving = !in_check && (ply <= 1 || stack[ply].eval > stack[ply - 2].eval);
 
         // Probe endgame tablebases
@@ -228,6 +259,11 @@ namespace pvs {
             }
         }
 
+        // Drawn king and pawn against king endgames are scored exactly by the KPK bitbase
+        if (ply && eg_kpk_draw(*board)) {
+            return 0;
+        }
+
         // Internal iterative deepening
         if (depth > 6 && tt_move == EMPTY_MOVE) {
             search_pv(alpha, beta, ply, depth - 6, aborted);
@@ -235,7 +271,7 @@ namespace pvs {
             if (tt->probe(board->record.back().hash, h)) {
                 stack[ply].eval = h.info.static_eval;
                 h_bound = h.bound();
-                tt_move = board->to_move(h.info.move);
+                tt_move = h.info.move;
             }
         }
 
@@ -246,12 +282,15 @@ namespace pvs {
 
         // Generate, sort, and determine search parameters
         int n_legal = 0;
-        movesort_t gen(NORMAL, heur, *board, tt_move, EMPTY_MOVE, ply);
+        movesort_t gen(heur, *board, stack[ply].attacks, tt_move, EMPTY_MOVE, ply, depth);
         for (move_t move = gen.next(stage, move_score, false);
              move != EMPTY_MOVE; move = gen.next(stage, move_score, false)) {
             if (board->is_legal(move)) {
                 n_legal++;
 
+                // The first moves are searched soon after the move list is built, so prefetch their entries now
+                if (n_legal <= 3) tt->prefetch(board->key_after(move));
+
                 bool move_is_check = board->gives_check(move);
                 int ex = move_is_check;
 
@@ -274,7 +313,6 @@ namespace pvs {
                     // LMR
                     R = depth / 8 + n_legal / 8 - improving;
                     if (stage == GEN_QUIETS && move_score < 0) R++;
-                    if (R >= 1 && board->see(reverse(move)) < 0) R -= 2;
                 }
 
                 move_list.emplace_back(move, n_legal, depth - R - 1 + ex, depth - 1 + ex);
@@ -300,9 +338,11 @@ namespace pvs {
                     if (score >= beta) {
                         tt->save(tt::LOWER, board->record.back().hash, depth, ply, stack[ply].eval, score, best_move);
 
-                        if (!move_list[0].move.info.is_capture) {
-                            heur.history.update(move_list[0].move, depth * depth);
+                        if (!board->is_capture(move_list[0].move)) {
+                            heur.history.update(board->record.back().next_move, move_list[0].move, depth * depth);
                             heur.killers.update(move_list[0].move, ply);
+                        } else {
+                            heur.capture_history.update(*board, move_list[0].move, depth * depth);
                         }
 
                         return beta; // Fail hard
@@ -351,7 +391,8 @@ namespace pvs {
 
         if (alpha > old_alpha) {
             tt->save(tt::EXACT, board->record.back().hash, depth, ply, stack[ply].eval, alpha, best_move);
-            if (!best_move.info.is_capture) heur.history.update(best_move, depth * depth);
+            if (!board->is_capture(best_move)) heur.history.update(board->record.back().next_move, best_move, depth * depth);
+            else heur.capture_history.update(*board, best_move, depth * depth);
         } else {
             tt->save(tt::UPPER, board->record.back().hash, depth, ply, stack[ply].eval, alpha, best_move);
         }
@@ -360,16 +401,15 @@ namespace pvs {
     }
 
     template<bool PV>
-    int context_t::search_qs(int alpha, int beta, const int ply, const std::atomic_bool &aborted) {
-        nodes++;
-
+    int context_t::search_qs(int alpha, int beta, const int ply, std::atomic_bool &aborted, const int qs_ply) {
         if (PV) pv_table_len[ply] = ply;
 
+        if (aborted) return TIMEOUT;
+
+        count_node(aborted);
         sel_depth = std::max(sel_depth, ply);
 
-        if (aborted) {
-            return TIMEOUT;
-        } else if (ply > MAX_PLY) {
+        if (ply > MAX_PLY) {
             return evaluator->evaluate(*board);
         }
 
@@ -387,7 +427,7 @@ namespace pvs {
             if (h_bound == tt::UPPER && score <= alpha) return score;
             if (h_bound == tt::EXACT) return score;
         } else {
-            stack[ply].eval = evaluator->evaluate(*board);
+            stack[ply].eval = evaluator->evaluate(*board, stack[ply].attacks);
         }
 
         // Probe endgame tablebases
@@ -417,22 +457,32 @@ namespace pvs {
             }
         }
 
-        if (stack[ply].eval >= beta) return beta;
-        if (alpha < stack[ply].eval) alpha = stack[ply].eval;
+        // Stand pat, unless in check near the start of the quiescence search where every evasion is searched instead
+        bool in_check = is_incheck(ply);
+        bool evasions = in_check && qs_ply < QS_EVASION_PLIES;
+        if (!evasions) {
+            if (stack[ply].eval >= beta) return beta;
+            if (alpha < stack[ply].eval) alpha = stack[ply].eval;
+        }
 
-        GenStage stage = GEN_NONE;
         move_t move{};
         int move_score;
-        movesort_t gen(QUIESCENCE, heur, *board, EMPTY_MOVE, EMPTY_MOVE, 0);
-        while ((move = gen.next(stage, move_score, true)) != EMPTY_MOVE) {
-            if (stack[ply].eval + move_score < alpha - 128) break; // Delta pruning
+        int n_legal = 0;
+        qmovesort_t gen(heur, *board, stack[ply].attacks);
+        while ((move = gen.next(move_score)) != EMPTY_MOVE) {
+            if (!in_check && stack[ply].eval + move_score < alpha - 128) break; // Delta pruning
+            if (in_check && !evasions && !board->is_capture(move) && !is_promotion(move)) break; // Quiets come last
+
+            tt->prefetch(board->key_after(move));
+            evaluator->prefetch(board->pawn_key_after(move));
 
             board->move(move);
             if (board->is_illegal()) {
                 board->unmove();
                 continue;
             } else {
-                int score = -search_qs<PV>(-beta, -alpha, ply + 1, aborted);
+                n_legal++;
+                int score = -search_qs<PV>(-beta, -alpha, ply + 1, aborted, qs_ply + 1);
                 board->unmove();
 
                 if (aborted) return TIMEOUT;
@@ -450,10 +500,15 @@ namespace pvs {
             }
         }
 
+        // Checkmate
+        if (evasions && n_legal == 0) {
+            return -TO_MATE_SCORE(ply);
+        }
+
         return alpha;
     }
 
-    int context_t::search_zw(int beta, const int ply, const int depth, const std::atomic_bool &aborted, move_t excluded) {
+    int context_t::search_zw(int beta, const int ply, const int depth, std::atomic_bool &aborted, move_t excluded) {
         if (aborted) {
             return TIMEOUT;
         } else if (ply > MAX_PLY) {
@@ -464,15 +519,23 @@ namespace pvs {
         if (depth < 1) return search_qs<false>(beta - 1, beta, ply, aborted);
 
         // Count node if we didn't go into quiescence search
-        nodes++;
+        count_node(aborted);
+
+        // A draw is available if a move can repeat a position within the search
+        int repetition = board->upcoming_repetition();
+        stack[ply].may_repeat = repetition != 0;
+        if (repetition && repetition < ply && beta <= 0) {
+            return 0;
+        }
 
         // Search variables
         int score, best_score = -INF;
         move_t best_move = EMPTY_MOVE;
 
-        // Game state
+        // Game state, only scanning for repetitions if the last move could have repeated a position
         if (board->record.back().halfmove_clock >= 100
-            || board->is_repetition_draw(ply)
+            || ((stack[ply - 1].may_repeat || board->record.back().prev_move == EMPTY_MOVE)
+                && board->is_repetition_draw(ply))
             || board->is_material_draw()) {
             return 0;
         }
@@ -496,10 +559,10 @@ namespace pvs {
                 if (h_bound == tt::EXACT) return std::clamp(score, beta - 1, beta);
             }
 
-            tt_move = board->to_move(h.info.move);
+            tt_move = h.info.move;
         } else {
             score = -INF;
-            stack[ply].eval = evaluator->evaluate(*board);
+            stack[ply].eval = evaluator->evaluate(*board, stack[ply].attacks);
         }
 
         // Probe endgame tablebases
@@ -529,7 +592,12 @@ namespace pvs {
             }
         }
 
-        bool in_check = board->is_incheck();
+        // Drawn king and pawn against king endgames are scored exactly by the KPK bitbase
+        if (ply && eg_kpk_draw(*board)) {
+            return 0;
+        }
+
+        bool in_check = is_incheck(ply);
         bool improving = !in_check && (ply <= 1 || stack[ply].eval > stack[ply - 2].eval);
         bool non_pawn_material = multiple_bits(board->non_pawn_material(board->record.back().next_move));
 
@@ -558,7 +626,7 @@ namespace pvs {
 
                 tt::entry_t null_entry = {};
                 if (tt->probe(board->record.back().hash, null_entry)) {
-                    refutation = board->to_move(null_entry.info.move);
+                    refutation = null_entry.info.move;
                 }
 
                 board->unmove();
@@ -577,8 +645,10 @@ namespace pvs {
         GenStage stage = GEN_NONE;
         move_t move{};
         int move_score;
-        movesort_t gen(NORMAL, heur, *board, tt_move, refutation, ply);
+        movesort_t gen(heur, *board, stack[ply].attacks, tt_move, refutation, ply, depth);
         int searched = 0;
+        move_t searched_captures[32];
+        int n_searched_captures = 0;
         while ((move = gen.next(stage, move_score, skip_quiets)) != EMPTY_MOVE) {
             if (excluded == move || !board->is_legal(move)) {
                 continue;
@@ -606,6 +676,10 @@ namespace pvs {
                 } else if (stage == GEN_BAD_NOISY && depth <= 4) continue;
             }
 
+            // The move will be searched, so prefetch the entries of the child position while it is considered further
+            tt->prefetch(board->key_after(move));
+            evaluator->prefetch(board->pawn_key_after(move));
+
             // Singular extension
             if (depth >= 8 && move == tt_move
                 && (h_bound == tt::LOWER || h_bound == tt::EXACT)
@@ -620,13 +694,12 @@ namespace pvs {
                 }
             }
 
+            bool move_is_quiet = board->is_quiet(move);
+            if (board->is_capture(move) && n_searched_captures < 32) searched_captures[n_searched_captures++] = move;
+
             board->move(move);
             searched++;
 
-            // Prefetch
-            tt->prefetch(board->record.back().hash);
-            evaluator->prefetch(board->record.back().kp_hash);
-
             // Check and castling extensions
             if (move_is_check) {
                 ex = 1;
@@ -637,7 +710,7 @@ namespace pvs {
                 // LMR
                 int R = 1 + depth / 8 + searched / 8 - improving;
                 if (stage == GEN_QUIETS && move_score < 0) R++;
-                if (R >= 1 && board->see(reverse(move)) < 0) R -= 2;
+                if (R >= 1 && move_is_quiet && !board->see_ge(reverse(move), 0)) R -= 2;
 
                 if (R > 0) {
                     score = -search_zw(1 - beta, ply + 1, depth - R - 1 + ex, aborted);
@@ -660,15 +733,22 @@ namespace pvs {
                 if (score >= beta) {
                     tt->prefetch(board->record.back().hash);
 
-                    if (!move.info.is_capture) {
+                    int bonus = depth * depth;
+                    for (int i = 0; i < n_searched_captures; i++) {
+                        if (searched_captures[i] != move) heur.capture_history.update(*board, searched_captures[i], -bonus);
+                    }
+
+                    if (board->is_capture(move)) {
+                        heur.capture_history.update(*board, move, bonus);
+                    } else {
                         size_t n_prev_quiets;
                         move_t *prev_quiets = gen.generated_quiets(n_prev_quiets);
-                        int bonus = depth * depth;
+                        Team team = board->record.back().next_move;
                         for (size_t i = 0; i < n_prev_quiets; i++) {
-                            heur.history.update(prev_quiets[i], -bonus);
+                            heur.history.update(team, prev_quiets[i], -bonus);
                         }
 
-                        heur.history.update(move, bonus);
+                        heur.history.update(team, move, bonus);
                         heur.killers.update(move, ply);
                     }
 
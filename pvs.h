@@ -14,23 +14,33 @@
 #include "move.h"
 #include "eval.h"
 #include "movesort.h"
+#include "attacks.h"
 
 namespace pvs {
     class alignas(64) context_t {
         struct stack_entry_t {
             // Initialised upon entering a node
             int eval;
+            bool may_repeat; // Whether a reversible move may return to an earlier position
+
+            // Built by the evaluation, and reused by the rest of the node
+            attack_map_t attacks;
         };
     public:
         // Constructor
-        context_t(board_t *board, evaluator_t *evaluator, tt::hash_t *tt, int use_tb)
-                : board(board), evaluator(evaluator), tt(tt), use_tb(use_tb) {}
+        context_t(board_t *board, evaluator_t *evaluator, tt::hash_t *tt, int use_tb,
+                  std::atomic<U64> *shared_nodes = nullptr, U64 node_limit = UINT64_MAX,
+                  const std::atomic_bool *main_pv_saved = nullptr)
+                : board(board), evaluator(evaluator), tt(tt), use_tb(use_tb),
+                  shared_nodes(shared_nodes), node_limit(node_limit), main_pv_saved(main_pv_saved) {
+            next_poll = std::min(NODE_POLL_INTERVAL, node_limit);
+        }
         context_t() = default;
 
         // Search
         int search_root(std::vector<move_t> root_moves,
                 const std::function<void(int)> &output_info, const std::function<void(int, move_t)> &output_currmove,
-                int alpha, int beta, int depth, const std::atomic_bool &aborted);
+                int alpha, int beta, int depth, std::atomic_bool &aborted);
 
         // Principal variation
         std::vector<move_t> get_current_pv() {
@@ -62,10 +72,23 @@ namespace pvs {
             return tb_hits;
         }
     private:
-        int search_pv(int alpha, int beta, int ply, int depth, const std::atomic_bool &aborted);
+        int search_pv(int alpha, int beta, int ply, int depth, std::atomic_bool &aborted);
         template<bool PV>
-        int search_qs(int alpha, int beta, int ply, const std::atomic_bool &aborted);
-        int search_zw(int beta, int ply, int depth, const std::atomic_bool &aborted, move_t excluded = EMPTY_MOVE);
+        int search_qs(int alpha, int beta, int ply, std::atomic_bool &aborted, int qs_ply = 0);
+        int search_zw(int beta, int ply, int depth, std::atomic_bool &aborted, move_t excluded = EMPTY_MOVE);
+
+        // Count a node, and raise the abort flag once the shared node budget is spent
+        void count_node(std::atomic_bool &aborted) {
+            if (++nodes >= next_poll) poll_nodes(aborted);
+        }
+
+        void poll_nodes(std::atomic_bool &aborted);
+
+        // Whether the side to move is in check, from the attack map of the node if it has already been built
+        bool is_incheck(int ply) const {
+            const attack_map_t &attacks = stack[ply].attacks;
+            return attacks.is_current(*board) ? attacks.is_incheck(*board) : board->is_incheck();
+        }
 
         void update_pv(int ply, move_t move) {
             pv_table[ply][ply] = move;
@@ -80,6 +103,18 @@ namespace pvs {
         tt::hash_t *tt; // Pointer to shared transposition table
         int use_tb; // Max pieces before probing tablebases
 
+        // Node limit
+        static constexpr U64 NODE_POLL_INTERVAL = 1024;
+
+        // Quiescence plies in which quiet check evasions are searched. Deeper in, a side in check stands pat and only
+        // tries noisy evasions, so that checks answered by checks cannot run on to MAX_PLY.
+        static constexpr int QS_EVASION_PLIES = 4;
+        std::atomic<U64> *shared_nodes = nullptr; // Nodes searched by all threads, updated every poll
+        U64 node_limit = UINT64_MAX; // Node budget shared between all threads
+        U64 next_poll = UINT64_MAX; // Local node count at which to poll the shared node count
+        const std::atomic_bool *main_pv_saved = nullptr; // Whether the main thread has a move, or nullptr for this context's own PV
+        U64 polled_nodes = 0; // Local nodes already added to the shared node count
+
         // Principal variation table
         int pv_table_len[MAX_PLY + 1] = {};
         move_t pv_table[MAX_PLY + 1][MAX_PLY + 1] = {{}};
@@ -5,17 +5,40 @@
 #include <utility>
 #include <vector>
 #include <algorithm>
+#include <sstream>
 
 #include "search.h"
+#include "output.h"
 
 #include "syzygy/tbprobe.h"
 #include "syzygy/tbresolve.h"
 
 search_t::search_t(tt::hash_t *tt, const processed_params_t &params, int threads, bool silent)
-        : tt(tt), params(params), limits(nullptr), silent(silent) {
+        : tt(tt), params(params), limits(nullptr), silent(silent), resolver_evaluator(params, 1 * MB) {
+    set_threads(threads);
+}
 
-    // Create an evaluator for each thread
+search_t::~search_t() {
+    finish_resolve(true);
+    set_threads(0);
+}
+
+void search_t::set_threads(size_t threads) {
+    // Stop the surplus workers, keeping the others with their heuristics and caches
+    for (size_t tid = threads; tid < workers.size(); tid++) {
+        {
+            std::lock_guard<std::mutex> lock(workers[tid]->mutex);
+            workers[tid]->terminated = true;
+        }
+        workers[tid]->cv.notify_one();
+    }
+
+    while (workers.size() > threads) {
+        workers.back()->thread.join();
+        workers.pop_back();
+    }
 
+    // Create an evaluator for each new thread
     std::function<void(worker_t*)> worker_loop = [this] (worker_t *worker) {
         while (!worker->terminated) {
             std::unique_lock<std::mutex> lock(worker->mutex);
@@ -27,22 +50,9 @@ search_t::search_t(tt::hash_t *tt, const processed_params_t &params, int threads
         }
     };
 
-    for (size_t i = 0; i < threads; i++) {
-        workers.emplace_back(std::make_unique<worker_t>(i, std::ref(params), 8 * MB, std::ref(worker_loop)));
-    }
-}
-
-search_t::~search_t() {
-    for (auto &worker : workers) {
-        {
-            std::lock_guard<std::mutex> lock(worker->mutex);
-            worker->terminated = true;
-        }
-        worker->cv.notify_one();
-    }
-
-    for (auto &worker : workers) {
-        worker->thread.join();
+    while (workers.size() < threads) {
+        workers.emplace_back(std::make_unique<worker_t>(workers.size(), std::ref(params), 8 * MB, worker_loop));
+        workers.back()->evaluator.set_network(network.get());
     }
 }
 
@@ -108,8 +118,9 @@ search_result_t search_t::think(board_t &board, const search_limits_t &search_li
 
         tt::entry_t h = {};
         move_t ponder_move = EMPTY_MOVE;
-        if (tt->probe(board.record.back().hash, h)) {
-            ponder_move = board.to_move(h.info.move);
+        if (tt->probe(board.record.back().hash, h)
+            && board.is_pseudo_legal(h.info.move) && board.is_legal(h.info.move)) {
+            ponder_move = h.info.move;
         }
 
         board.unmove();
@@ -117,12 +128,26 @@ search_result_t search_t::think(board_t &board, const search_limits_t &search_li
         return {root_moves[0], ponder_move};
     }
 
+    // Instantly play a book move in a game
+    if (limits->game_situation && book && board.record.size() <= size_t(2 * book_depth)) {
+        move_t book_move = book->probe(board);
+        if (book_move != EMPTY_MOVE && std::find(root_moves.begin(), root_moves.end(), book_move) != root_moves.end()) {
+            return {book_move, EMPTY_MOVE};
+        }
+    }
+
     // Start workers
     std::vector<std::future<void>> futures;
+    shared_nodes = 0;
+    main_pv_saved = false;
+    root_score = 0;
+    root_depth = 0;
     for (auto &worker : workers) {
         // Initialise worker
         worker->board = board;
-        worker->context = pvs::context_t(&worker->board, &worker->evaluator, tt, use_tb);
+        worker->evaluator.reset_stats();
+        worker->context = pvs::context_t(&worker->board, &worker->evaluator, tt, use_tb,
+                                         &shared_nodes, search_limits.node_limit, &main_pv_saved);
         worker->aborted = &aborted;
 
         std::promise<void> promise = std::promise<void>();
@@ -151,12 +176,28 @@ search_result_t search_t::think(board_t &board, const search_limits_t &search_li
     }
 #endif
 
+    // Whether the search was cut short by time, a stop or the node limit, rather than finishing on its own
+    bool stopped = aborted;
+
     // Then abort and wait for all the helper threads
     aborted = true;
     for (size_t tid = 1; tid < workers.size(); tid++) {
         futures[tid].wait();
     }
 
+    // Publish the last PV resolution before the best move is printed, if it finishes within the time left for the move
+    if (stopped) {
+        finish_resolve(true);
+    } else {
+        auto elapsed = timer_started ? CHRONO_DIFF(timer_start, engine_clock::now()) : 0;
+        finish_resolve(false, std::chrono::milliseconds(std::max<long long>(0, search_limits.hard_time_limit - elapsed)));
+    }
+
+    // Only UCI output reports cache hit rates, since other consumers receive their info through the callback
+    if (!silent && !info_callback) {
+        print_cache_stats();
+    }
+
     // Read the PV
     std::vector<move_t> pv = workers[0]->context.get_saved_pv();
     if (pv.empty()) {
@@ -170,8 +211,9 @@ search_result_t search_t::think(board_t &board, const search_limits_t &search_li
 
         tt::entry_t h = {};
         move_t ponder_move = EMPTY_MOVE;
-        if (tt->probe(board.record.back().hash, h)) {
-            ponder_move = board.to_move(h.info.move);
+        if (tt->probe(board.record.back().hash, h)
+            && board.is_pseudo_legal(h.info.move) && board.is_legal(h.info.move)) {
+            ponder_move = h.info.move;
         }
 
         board.unmove();
@@ -179,7 +221,12 @@ search_result_t search_t::think(board_t &board, const search_limits_t &search_li
         pv.push_back(ponder_move);
     }
 
-    return {pv[0], pv[1]};
+    search_result_t result = {pv[0], pv[1]};
+    result.score = root_score;
+    result.depth = root_depth;
+    result.pv = std::move(pv);
+    result.nodes = count_nodes();
+    return result;
 }
 
 void search_t::enable_timer() {
@@ -200,7 +247,28 @@ void search_t::reset_timer() {
     timer_started = false;
 }
 
-void search_t::thread_start(pvs::context_t &context, const std::atomic_bool &aborted, worker_t *worker) {
+void search_t::set_info_callback(std::function<void(const search_info_t &)> callback) {
+    info_callback = std::move(callback);
+}
+
+void search_t::set_output(output::writer_t &writer) {
+    out = &writer;
+}
+
+void search_t::set_book(std::shared_ptr<const book::book_t> book, int depth) {
+    this->book = std::move(book);
+    book_depth = depth;
+}
+
+void search_t::set_network(std::shared_ptr<const nnue::network_t> network) {
+    this->network = std::move(network);
+    for (auto &worker : workers) {
+        worker->evaluator.set_network(this->network.get());
+    }
+    resolver_evaluator.set_network(this->network.get());
+}
+
+void search_t::thread_start(pvs::context_t &context, std::atomic_bool &aborted, worker_t *worker) {
     int prev_score = 0;
 
     // Check if this is the main thread
@@ -214,6 +282,9 @@ void search_t::thread_start(pvs::context_t &context, const std::atomic_bool &abo
             int score = search_aspiration(context, prev_score, depth, aborted, worker->tid);
             if (aborted) break;
 
+            root_score = score;
+            root_depth = depth;
+
             // If in game situation, try and manage time
             if (limits->game_situation && timer_started) {
                 auto elapsed = CHRONO_DIFF(timer_start, engine_clock::now());
@@ -238,7 +309,7 @@ void search_t::thread_start(pvs::context_t &context, const std::atomic_bool &abo
     }
 }
 
-int search_t::search_aspiration(pvs::context_t &context, int prev_score, int depth, const std::atomic_bool &aborted,
+int search_t::search_aspiration(pvs::context_t &context, int prev_score, int depth, std::atomic_bool &aborted,
                                 size_t tid) {
     const int ASPIRATION_DELTA = 15;
 
@@ -260,14 +331,15 @@ int search_t::search_aspiration(pvs::context_t &context, int prev_score, int dep
     while (true) {
         assert(alpha <= beta);
 
-        if (!silent && tid == 0 && time > 1000) {
+        if (!silent && !info_callback && tid == 0 && time > 1000) {
             score = context.search_root(root_moves,
-                                        [this, &context, tid, depth, &aborted](int score) {
-                                            print_stats(*context.get_board(), score, depth, tt::EXACT, aborted);
+                                        [this, &context, depth](int score) {
+                                            print_stats(*context.get_board(), score, depth, tt::EXACT);
                                         },
-                                        [](int num, move_t move) {
-                                            std::cout << "info currmove " << move << " currmovenumber " << num
-                                                      << std::endl;
+                                        [this](int num, move_t move) {
+                                            std::ostringstream currmove;
+                                            currmove << "info currmove " << move << " currmovenumber " << num;
+                                            writer().currmove(currmove.str());
                                         },
                                         alpha, beta, depth, aborted);
         } else {
@@ -279,18 +351,20 @@ int search_t::search_aspiration(pvs::context_t &context, int prev_score, int dep
         // Only save the principal variation if the bound is LOWER or EXACT
         if (score >= beta) {
             context.save_pv();
+            if (tid == 0) main_pv_saved = true;
             if (!silent && tid == 0) {
-                print_stats(*context.get_board(), score, depth, tt::LOWER, aborted);
+                print_stats(*context.get_board(), score, depth, tt::LOWER);
             }
             beta = std::min(INF, beta + delta);
         } else if (score <= alpha) {
             if (!silent && tid == 0) {
-                print_stats(*context.get_board(), score, depth, tt::UPPER, aborted);
+                print_stats(*context.get_board(), score, depth, tt::UPPER);
             }
             beta = (alpha + beta) / 2;
             alpha = std::max(-INF, alpha - delta);
         } else {
             context.save_pv();
+            if (tid == 0) main_pv_saved = true;
             break;
         }
 
@@ -298,7 +372,7 @@ int search_t::search_aspiration(pvs::context_t &context, int prev_score, int dep
     }
 
     if (!silent && tid == 0) {
-        print_stats(*context.get_board(), score, depth, tt::EXACT, aborted);
+        print_stats(*context.get_board(), score, depth, tt::EXACT);
     }
 
     return score;
@@ -329,47 +403,106 @@ U64 search_t::count_tb_hits() {
     return total_tb_hits;
 }
 
-void search_t::print_stats(board_t &pos, int score, int depth, tt::Bound bound, const std::atomic_bool &aborted) {
-    U64 nodes = count_nodes();
-    auto time = CHRONO_DIFF(start, engine_clock::now());
+void search_t::print_cache_stats() {
+    evaluator_t::cache_stats_t total;
+    for (auto &worker : workers) {
+        const evaluator_t::cache_stats_t &stats = worker->evaluator.get_stats();
+        total.pawn_probes += stats.pawn_probes;
+        total.pawn_hits += stats.pawn_hits;
+        total.king_probes += stats.king_probes;
+        total.king_hits += stats.king_hits;
+    }
 
+    if (total.pawn_probes == 0) return;
+
+    std::ostringstream info;
+    info << "info string pawn hash hits " << (total.pawn_hits * 100 / total.pawn_probes) << "%"
+         << " king hash hits " << (total.king_hits * 100 / total.king_probes) << "%";
+    writer().write(info.str());
+}
+
+void search_t::print_stats(board_t &pos, int score, int depth, tt::Bound bound) {
     // Get an appropriate PV
     std::vector<move_t> pv = bound == tt::EXACT ? workers[0]->context.get_current_pv() : workers[0]->context.get_saved_pv();
+    auto sel_depth = size_t(workers[0]->context.get_sel_depth());
+
+    // A newer iteration supersedes any syzygy resolution still in progress
+    bool resolve = limits->syzygy_resolve > 0 && TBlargest > 0;
+    if (resolve) finish_resolve(true);
+
+    print_info(pv, score, depth, sel_depth, bound);
 
     // Try syzygy resolution
-    auto sel_depth = size_t(workers[0]->context.get_sel_depth());
-    if (limits->syzygy_resolve > 0) {
-        resolve_pv(pos, workers[0]->evaluator, pv, score, limits->syzygy_resolve, aborted);
-        sel_depth = std::max(pv.size(), sel_depth);
+    if (resolve) resolve_async(pos, std::move(pv), score, depth, sel_depth, bound);
+}
+
+void search_t::print_info(const std::vector<move_t> &pv, int score, int depth, size_t sel_depth, tt::Bound bound) {
+    U64 nodes = count_nodes();
+    auto time = CHRONO_DIFF(start, engine_clock::now());
+
+    if (info_callback) {
+        info_callback({depth, sel_depth, score, bound, nodes, U64(time), pv});
+        return;
     }
 
-    std::cout << "info depth " << depth << " seldepth " << sel_depth;
+    std::ostringstream info;
+    info << "info depth " << depth << " seldepth " << sel_depth;
 
     if (score > MINCHECKMATE) {
-        std::cout << " score mate " << ((TO_MATE_PLY(score) + 1) / 2);
+        info << " score mate " << ((TO_MATE_PLY(score) + 1) / 2);
     } else if (score < -MINCHECKMATE) {
-        std::cout << " score mate -" << ((TO_MATE_PLY(-score) + 1) / 2);
+        info << " score mate -" << ((TO_MATE_PLY(-score) + 1) / 2);
     } else {
-        std::cout << " score cp " << score;
+        info << " score cp " << score;
     }
 
     if (bound == tt::UPPER) {
-        std::cout << " upperbound";
+        info << " upperbound";
     } else if (bound == tt::LOWER) {
-        std::cout << " lowerbound";
+        info << " lowerbound";
     }
 
-    std::cout << " time " << time
-              << " nodes " << nodes
-              << " nps " << (nodes / (time + 1)) * 1000;
+    info << " time " << time
+         << " nodes " << nodes
+         << " nps " << (nodes / (time + 1)) * 1000;
     if (time > 1000) {
-        std::cout << " hashfull " << tt->hash_full()
-                  << " tbhits " << count_tb_hits();
+        info << " hashfull " << tt->hash_full()
+             << " tbhits " << count_tb_hits();
     }
-    std::cout << " pv ";
+    info << " pv ";
     for (const auto &move : pv) {
-        std::cout << move << " ";
+        info << move << " ";
+    }
+
+    writer().info(info.str());
+}
+
+void search_t::resolve_async(const board_t &board, std::vector<move_t> pv, int score, int depth, size_t sel_depth,
+                             tt::Bound bound) {
+    size_t max_ply = limits->syzygy_resolve;
+    resolver = std::async(std::launch::async,
+                          [this, pos = board, pv = std::move(pv), score, depth, sel_depth, bound, max_ply] () mutable {
+        size_t pv_len = pv.size();
+        int resolved_score = score;
+        bool resolved = resolve_pv(pos, resolver_evaluator, pv, resolved_score, max_ply, resolver_cancel);
+
+        // Only publish resolutions which tell the GUI something new
+        if (resolved && !resolver_cancel && (pv.size() != pv_len || resolved_score != score)) {
+            print_info(pv, resolved_score, depth, std::max(pv.size(), sel_depth), bound);
+        }
+    });
+}
+
+void search_t::finish_resolve(bool cancel, std::chrono::milliseconds timeout) {
+    if (resolver.valid()) {
+        resolver_cancel = cancel;
+        if (!cancel && timeout != std::chrono::milliseconds::max()
+            && resolver.wait_for(timeout) != std::future_status::ready) {
+            resolver_cancel = true;
+        }
+        resolver.wait();
+        resolver = std::future<void>();
     }
 
-    std::cout << std::endl;
+    resolver_cancel = false;
 }
@@ -22,6 +22,8 @@
 #include "eval.h"
 #include "movesort.h"
 #include "pvs.h"
+#include "output.h"
+#include "book.h"
 
 struct search_limits_t {
     // Game situation
@@ -66,6 +68,22 @@ struct search_limits_t {
 struct search_result_t {
     move_t best_move;
     move_t ponder;
+
+    // Result of the last completed iteration
+    int score = 0;
+    int depth = 0;
+    std::vector<move_t> pv = {};
+    U64 nodes = 0;
+};
+
+struct search_info_t {
+    int depth;
+    size_t sel_depth;
+    int score;
+    tt::Bound bound;
+    U64 nodes;
+    U64 time;
+    const std::vector<move_t> &pv;
 };
 
 class search_t {
@@ -101,27 +119,70 @@ public:
     void enable_timer();
     void wait_for_timer();
     void reset_timer();
+
+    // Replace UCI info output with a callback, which is never called concurrently
+    void set_info_callback(std::function<void(const search_info_t &)> callback);
+
+    // Write UCI output to the given writer rather than to standard output
+    void set_output(output::writer_t &writer);
+
+    // Play moves from an opening book in games, for the given number of moves after the set up position
+    void set_book(std::shared_ptr<const book::book_t> book, int depth);
+
+    // Evaluate with a neural network, or with the hand-crafted evaluation if null
+    void set_network(std::shared_ptr<const nnue::network_t> network);
+
+    // Add or remove search threads between searches. Threads that are kept keep their heuristics and caches.
+    void set_threads(size_t threads);
+
+    // Moves searched at the root by the last search, after the search moves and tablebases have filtered them
+    const std::vector<move_t> &searched_root_moves() const { return root_moves; }
 private:
-    void thread_start(pvs::context_t &context, const std::atomic_bool &aborted, worker_t *worker);
-    int search_aspiration(pvs::context_t &context, int prev_score, int depth, const std::atomic_bool &aborted, size_t tid);
+    void thread_start(pvs::context_t &context, std::atomic_bool &aborted, worker_t *worker);
+    int search_aspiration(pvs::context_t &context, int prev_score, int depth, std::atomic_bool &aborted, size_t tid);
 
     bool keep_searching(int depth);
 
     U64 count_nodes();
     U64 count_tb_hits();
-    void print_stats(board_t &board, int score, int depth, tt::Bound bound, const std::atomic_bool &aborted);
+    void print_stats(board_t &board, int score, int depth, tt::Bound bound);
+    void print_cache_stats(); // hit rates of the pawn structure and king shelter caches
+    void print_info(const std::vector<move_t> &pv, int score, int depth, size_t sel_depth, tt::Bound bound);
+
+    // Syzygy PV resolution runs on a copy of the board, away from the search threads
+    void resolve_async(const board_t &board, std::vector<move_t> pv, int score, int depth, size_t sel_depth,
+                       tt::Bound bound);
+    // Waits for the resolution, which is cancelled if requested or if it is still running after the timeout
+    void finish_resolve(bool cancel, std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
 
     bool silent;
+    std::function<void(const search_info_t &)> info_callback;
+    output::writer_t *out = nullptr;
+    output::writer_t &writer() { return out ? *out : output::uci(); }
+
+    std::shared_ptr<const book::book_t> book;
+    int book_depth = 0;
+
+    std::shared_ptr<const nnue::network_t> network;
 
     // Shared structures
     tt::hash_t *tt;
     const processed_params_t &params;
     search_limits_t const *limits;
     std::vector<move_t> root_moves;
+    int root_score = 0;
+    int root_depth = 0;
+    std::atomic<U64> shared_nodes{0};
+    std::atomic_bool main_pv_saved{false}; // Whether the main thread has saved a PV, before which the node limit is not enforced
 
     // Workers
     std::vector<std::unique_ptr<worker_t>> workers;
 
+    // Syzygy PV resolution
+    evaluator_t resolver_evaluator;
+    std::future<void> resolver;
+    std::atomic_bool resolver_cancel{false};
+
     // Timing
     std::mutex timer_mtx;
     std::condition_variable timer_cnd;
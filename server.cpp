@@ -0,0 +1,79 @@
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "server.h"
+#include "uci.h"
+
+#include "syzygy/tbprobe.h"
+
+namespace server {
+    namespace {
+        struct hosted_session_t {
+            hosted_session_t(const std::string &tag, const processed_params_t &params, uci::budget_t &budget) :
+                    out(std::cout, tag + " "), session(out, params, &budget) {}
+
+            // The writer outlives the session, which may write a last bestmove when destroyed
+            output::writer_t out;
+            uci::session_t session;
+        };
+    }
+
+    int serve(int argc, char *argv[]) {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t hash_mb = 1024;
+        std::string syzygy_path;
+
+        const char *usage = "usage: Topple server [--threads N] [--hash MB] [--syzygy path]";
+        for (int i = 0; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+
+            try {
+                if (arg == "--threads" && has_value) {
+                    threads = std::max(1, std::stoi(argv[++i]));
+                } else if (arg == "--hash" && has_value) {
+                    hash_mb = std::max(1, std::stoi(argv[++i]));
+                } else if (arg == "--syzygy" && has_value) {
+                    syzygy_path = argv[++i];
+                } else {
+                    std::cerr << usage << std::endl;
+                    return 1;
+                }
+            } catch (std::exception &) {
+                std::cerr << "error: invalid value " << argv[i] << " for " << arg << "\n" << usage << std::endl;
+                return 1;
+            }
+        }
+
+        if (!syzygy_path.empty()) init_tablebases(syzygy_path.c_str());
+
+        output::uci().write_now("Topple " TOPPLE_VER " (c) Vincent Tang 2020, server with " + std::to_string(threads)
+                                + " threads and " + std::to_string(hash_mb) + " MB hash");
+
+        processed_params_t params = processed_params_t(eval_params_t());
+        uci::budget_t budget(threads, hash_mb);
+        std::map<std::string, std::unique_ptr<hosted_session_t>> sessions;
+
+        std::string input;
+        while (std::getline(std::cin, input)) {
+            std::istringstream iss(input);
+            std::string tag, command;
+            if (!(iss >> tag)) continue;
+            std::getline(iss >> std::ws, command);
+
+            auto it = sessions.find(tag);
+            if (it == sessions.end()) {
+                it = sessions.emplace(tag, std::make_unique<hosted_session_t>(tag, params, budget)).first;
+            }
+
+            if (!it->second->session.handle(command)) {
+                sessions.erase(it);
+            }
+        }
+
+        return 0;
+    }
+}
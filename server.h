@@ -0,0 +1,21 @@
+#ifndef TOPPLE_SERVER_H
+#define TOPPLE_SERVER_H
+
+namespace server {
+    /**
+     * Host many independent UCI sessions in one process. Every line of input starts with a session tag, followed by a
+     * UCI command for that session, and every line of output is prefixed with the tag of the session that wrote it.
+     * A session is created by the first command with its tag, and ends with "quit". Attack tables, evaluation
+     * parameters and tablebases are shared by all sessions, and search threads and hash memory are granted to sessions
+     * from a global budget.
+     *
+     * Usage: Topple server [--threads N] [--hash MB] [--syzygy path]
+     *
+     * @param argc number of arguments following the mode
+     * @param argv arguments following the mode
+     * @return process exit code
+     */
+    int serve(int argc, char *argv[]);
+}
+
+#endif //TOPPLE_SERVER_H
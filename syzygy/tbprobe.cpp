@@ -351,7 +351,7 @@ static int probe_ab(board_t& pos, int alpha, int beta, int *success)
 
     for (moves = stack; moves < end; moves++) {
         move_t capture = *moves;
-        if (!capture.info.is_capture || !pos.is_legal(capture))
+        if (!pos.is_capture(capture) || !pos.is_legal(capture))
             continue;
         pos.move(capture);
         v = -probe_ab(pos, -beta, -alpha, success);
@@ -404,7 +404,7 @@ int probe_wdl(board_t& pos, int *success)
 
     for (moves = stack; moves < end; moves++) {
         move_t capture = *moves;
-        if (!capture.info.is_capture || !pos.is_legal(capture))
+        if (!pos.is_capture(capture) || !pos.is_legal(capture))
             continue;
         pos.move(capture);
         int v = -probe_ab(pos, -2, -best_cap, success);
@@ -415,7 +415,7 @@ int probe_wdl(board_t& pos, int *success)
                 *success = 2;
                 return 2;
             }
-            if (!capture.info.is_ep)
+            if (!pos.is_ep(capture))
                 best_cap = v;
             else if (v > best_ep)
                 best_ep = v;
@@ -454,7 +454,7 @@ int probe_wdl(board_t& pos, int *success)
         // Check for stalemate in the position with ep captures.
         for (moves = stack; moves < end; moves++) {
             move_t move = *moves;
-            if (move.info.is_ep) continue;
+            if (pos.is_ep(move)) continue;
             if (pos.is_legal(move)) break;
         }
         if (moves == end && !pos.is_incheck()) {
@@ -533,7 +533,7 @@ int probe_dtz(board_t& pos, int *success)
 
         for (moves = stack; moves < end; moves++) {
             move_t move = *moves;
-            if (move.info.piece != PAWN || move.info.is_capture
+            if (pos.moving_piece(move) != PAWN || pos.is_capture(move)
                 || !pos.is_legal(move))
                 continue;
             pos.move(move);
@@ -573,7 +573,7 @@ int probe_dtz(board_t& pos, int *success)
         // We can skip pawn moves and captures.
         // If wdl > 0, we already caught them. If wdl < 0, the initial value
         // of best already takes account of them.
-        if (move.info.is_capture || move.info.piece == PAWN
+        if (pos.is_capture(move) || pos.moving_piece(move) == PAWN
             || !pos.is_legal(move))
             continue;
         pos.move(move);
@@ -29,7 +29,7 @@ bool resolve_pv(board_t &pos, evaluator_t &evaluator, std::vector<move_t> &pv,
             pos.unmove();
             pv.erase(it, pv.end());
 
-            std::cout << "dropped end of PV: " << (pv.end() - it) << std::endl;
+            std::cerr << "dropped end of PV: " << (pv.end() - it) << std::endl;
 
             break;
         }
@@ -6,6 +6,7 @@
 #pragma ide diagnostic ignored "UnusedImportStatement"
 
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_NO_POSIX_SIGNALS // MINSIGSTKSZ is no longer a constant expression in newer glibc
 #include "catch.hpp"
 
 #pragma clang diagnostic pop
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <string>
+#include "../catch.hpp"
+#include "../../topple.h"
+
+TEST_CASE("Embedding API") {
+    topple_engine *engine = topple_create(16, 1);
+    REQUIRE(engine != nullptr);
+
+    SECTION("Invalid positions are rejected") {
+        REQUIRE(topple_set_position(engine, "8/8/8/8 w", nullptr) == -1);
+        REQUIRE(topple_set_position(engine, nullptr, "e2e4 e2e4") == -1);
+        REQUIRE(topple_search(engine, nullptr, nullptr, nullptr) == -1);
+    }
+
+    SECTION("Search reports a best move, PV and score") {
+        REQUIRE(topple_set_position(engine, nullptr, "e2e4 e7e5") == 0);
+
+        int callbacks = 0;
+        topple_limits limits = {6, 0, 0};
+        REQUIRE(topple_search(engine, &limits, [](const topple_info *info, void *user_data) {
+            REQUIRE(info->depth >= 1);
+            REQUIRE(info->pv != nullptr);
+            (*static_cast<int *>(user_data))++;
+        }, &callbacks) == 0);
+        REQUIRE(callbacks > 0);
+
+        char best_move[8], pv[1024];
+        REQUIRE(topple_best_move(engine, best_move, sizeof(best_move)) >= 4);
+        REQUIRE(topple_pv(engine, pv, sizeof(pv)) >= 4);
+        REQUIRE(std::string(pv).rfind(best_move, 0) == 0);
+    }
+
+    SECTION("Mate is reported") {
+        REQUIRE(topple_set_position(engine, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", nullptr) == 0);
+
+        topple_limits limits = {4, 0, 0};
+        REQUIRE(topple_search(engine, &limits, nullptr, nullptr) == 0);
+
+        char best_move[8];
+        int mate = 0;
+        topple_best_move(engine, best_move, sizeof(best_move));
+        topple_score(engine, &mate);
+        REQUIRE(std::string(best_move) == "a1a8");
+        REQUIRE(mate == 1);
+    }
+
+    SECTION("Checks answered by checks do not run on in the quiescence search") {
+        // White is in check, and most evasions on either side give check back
+        REQUIRE(topple_set_position(engine, "Q7/3N1k2/3q4/b4K2/r2n1R2/3B4/8/8 w - - 0 1", nullptr) == 0);
+
+        int max_sel_depth = 0;
+        topple_limits limits = {0, 20000, 0};
+        REQUIRE(topple_search(engine, &limits, [](const topple_info *info, void *user_data) {
+            int &sel_depth = *static_cast<int *>(user_data);
+            sel_depth = std::max(sel_depth, info->seldepth);
+        }, &max_sel_depth) == 0);
+
+        char best_move[8];
+        REQUIRE(topple_best_move(engine, best_move, sizeof(best_move)) >= 4);
+        REQUIRE(max_sel_depth > 0);
+        REQUIRE(max_sel_depth < 32);
+    }
+
+    SECTION("A stop before the search starts is not lost") {
+        REQUIRE(topple_set_position(engine, nullptr, nullptr) == 0);
+
+        // Without the stop, this search would only end after a minute
+        topple_limits limits = {0, 0, 60000};
+        topple_stop(engine);
+        REQUIRE(topple_search(engine, &limits, nullptr, nullptr) == -1);
+
+        // The stop only ends one search
+        limits.depth = 2;
+        REQUIRE(topple_search(engine, &limits, nullptr, nullptr) == 0);
+    }
+
+    topple_destroy(engine);
+}
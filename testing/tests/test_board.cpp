@@ -3,9 +3,12 @@
 //
 
 #include <iostream>
+#include <random>
 #include "../catch.hpp"
 #include "../util.h"
 #include "../../board.h"
+#include "../../attacks.h"
+#include "../../movegen.h"
 
 TEST_CASE("Board representation") {
     REQUIRE_NOTHROW(init_tables());
@@ -177,7 +180,6 @@ TEST_CASE("Board representation") {
         move_t move = EMPTY_MOVE;
         move.info.from = E2;
         move.info.to = E4;
-        move.info.piece = PAWN;
 
         board.move(move);
 
@@ -236,4 +238,145 @@ TEST_CASE("Legality") {
     board_t board3("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 ");
     INFO(board3 << board3.parse_move("d7c8q"));
     REQUIRE(board3.is_legal(board3.parse_move("d7c8q")));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Upcoming repetition") {
+    init_tables();
+    zobrist::init_hashes();
+
+    board_t board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    for (const std::string &move : {"g1f3", "g8f6", "f3g1"}) {
+        REQUIRE(board.upcoming_repetition() == 0);
+        board.move(board.parse_move(move));
+    }
+
+    // Black can return to the starting position with f6g8
+    REQUIRE(board.upcoming_repetition() == 3);
+
+    // The rook cannot return to a1 through the knight
+    board_t blocked("4k3/8/8/8/8/8/8/R2n3K b - - 0 1");
+    for (const std::string &move : {"d1b2", "a1e1", "b2d1"}) {
+        blocked.move(blocked.parse_move(move));
+    }
+    REQUIRE(blocked.upcoming_repetition() == 0);
+}
+
+TEST_CASE("Attack map") {
+    init_tables();
+    zobrist::init_hashes();
+
+    const std::vector<std::string> fens = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"
+    };
+
+    std::mt19937 rng(11);
+    for (const std::string &fen : fens) {
+        board_t board(fen);
+        attack_map_t attacks;
+
+        // Random playout, comparing everything the attack map is used for with the direct lookups
+        for (int step = 0; step < 60; step++) {
+            attacks.update(board);
+            REQUIRE(attacks.is_current(board));
+            REQUIRE(attacks.is_incheck(board) == board.is_incheck());
+
+            move_t moves[256], mapped_moves[256];
+            int count = movegen_t(board).gen_normal(moves);
+            REQUIRE(movegen_t(board, attacks).gen_normal(mapped_moves) == count);
+
+            for (int i = 0; i < count; i++) {
+                INFO(fen << " " << moves[i]);
+                REQUIRE(mapped_moves[i] == moves[i]);
+                if (board.is_capture(moves[i])) {
+                    REQUIRE(board.see(moves[i], attacks) == board.see(moves[i]));
+                    REQUIRE(board.see_ge(moves[i], 0, attacks) == board.see_ge(moves[i], 0));
+                }
+            }
+
+            bool moved = false;
+            for (int tries = 0; tries < count && !moved; tries++) {
+                board.move(moves[rng() % count]);
+                if (board.is_illegal()) {
+                    board.unmove();
+                } else {
+                    moved = true;
+                }
+            }
+            if (!moved) break;
+            REQUIRE(!attacks.is_current(board));
+        }
+    }
+}
+
+TEST_CASE("Check evasions") {
+    init_tables();
+    zobrist::init_hashes();
+
+    const std::vector<std::string> fens = {
+            "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", // Checkmate
+            "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1", // En passant capture of the checker
+            "K6r/1P6/8/8/8/8/8/1k6 w - - 0 1", // Promotion between the checker and the king
+            "4k3/8/8/8/8/5n2/8/r3K3 w - - 0 1", // Double check
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"
+    };
+
+    auto legal_moves = [](board_t &board, const move_t *moves, int count) {
+        std::vector<uint32_t> legal;
+        for (int i = 0; i < count; i++) {
+            board.move(moves[i]);
+            if (!board.is_illegal()) legal.push_back(moves[i].hash);
+            board.unmove();
+        }
+        std::sort(legal.begin(), legal.end());
+        return legal;
+    };
+
+    std::mt19937 rng(5);
+    int checks = 0;
+    for (const std::string &fen : fens) {
+        board_t board(fen);
+
+        // Random playout, comparing the evasions with all legal moves whenever the side to move is in check
+        for (int step = 0; step < 200; step++) {
+            move_t moves[256], evasions[256];
+            int count = movegen_t(board).gen_normal(moves);
+
+            if (board.is_incheck()) {
+                checks++;
+                int n_evasions = movegen_t(board).gen_evasions(evasions);
+                INFO(fen << " " << step);
+                REQUIRE(legal_moves(board, evasions, n_evasions) == legal_moves(board, moves, count));
+
+                attack_map_t attacks;
+                attacks.update(board);
+                move_t mapped_evasions[256];
+                REQUIRE(movegen_t(board, attacks).gen_evasions(mapped_evasions) == n_evasions);
+                for (int i = 0; i < n_evasions; i++) {
+                    REQUIRE(mapped_evasions[i] == evasions[i]);
+                    if (board.moving_piece(evasions[i]) == KING) REQUIRE(board.is_legal(evasions[i]));
+                }
+            }
+
+            // Prefer checking moves, so that most positions are in check
+            bool moved = false;
+            for (int tries = 0; tries < count * 2 && !moved; tries++) {
+                move_t move = moves[rng() % count];
+                if (tries < count && !board.gives_check(move)) continue;
+
+                board.move(move);
+                if (board.is_illegal()) {
+                    board.unmove();
+                } else {
+                    moved = true;
+                }
+            }
+            if (!moved) break;
+        }
+    }
+
+    REQUIRE(checks > 50);
+}
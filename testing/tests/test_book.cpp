@@ -0,0 +1,57 @@
+#include "../catch.hpp"
+#include "../util.h"
+#include "../../board.h"
+#include "../../book.h"
+#include "../../eval.h"
+
+TEST_CASE("Polyglot keys") {
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+
+    // Test positions from the Polyglot book format specification
+    const std::vector<std::pair<std::string, U64>> positions = {
+            {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cULL},
+            {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL},
+            {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL},
+            {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL},
+            {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL},
+            {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL},
+            {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL},
+            {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL},
+            {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL}
+    };
+
+    for (const auto &[fen, key] : positions) {
+        board_t board(fen);
+        REQUIRE(book::polyglot_key(board) == key);
+    }
+
+    // Keys must not depend on how the position was reached
+    board_t board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    for (const std::string &move : {"e2e4", "d7d5", "e4e5", "f7f5", "e1e2", "e8f7"}) {
+        board.move(board.parse_move(move));
+    }
+    REQUIRE(book::polyglot_key(board) == 0x00fdd303c946bdd9ULL);
+}
+
+TEST_CASE("Polyglot moves") {
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+
+    board_t board("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+
+    // Castling is written as the king capturing its rook
+    auto encode = [](const std::string &from, const std::string &to) {
+        return uint16_t(to_sq(to[0], to[1]) | (to_sq(from[0], from[1]) << 6u));
+    };
+    REQUIRE(book::to_move(board, encode("e1", "h1")) == board.parse_move("e1g1"));
+    REQUIRE(book::to_move(board, encode("e1", "a1")) == board.parse_move("e1c1"));
+    REQUIRE(book::to_move(board, encode("a1", "a8")) == board.parse_move("a1a8"));
+    REQUIRE(book::to_move(board, encode("e1", "e3")) == EMPTY_MOVE);
+
+    board_t promotion("8/4P3/8/8/8/8/k7/4K3 w - - 0 1");
+    REQUIRE(book::to_move(promotion, uint16_t(encode("e7", "e8") | (4u << 12u))) == promotion.parse_move("e7e8q"));
+    REQUIRE(book::move_str(uint16_t(encode("e7", "e8") | (1u << 12u))) == "e7e8n");
+}
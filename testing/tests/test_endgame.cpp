@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cstdlib>
+
+#include "../catch.hpp"
+#include "../util.h"
+#include "../../board.h"
+#include "../../eval.h"
+#include "../../endgame.h"
+#include "../../syzygy/tbprobe.h"
+
+namespace {
+    std::string kpk_fen(uint8_t w_king, uint8_t pawn, uint8_t b_king, Team side) {
+        std::string fen;
+        for (int rank = 7; rank >= 0; rank--) {
+            int empty = 0;
+            for (int file = 0; file < 8; file++) {
+                uint8_t sq = square_index(file, rank);
+                char piece = sq == w_king ? 'K' : sq == pawn ? 'P' : sq == b_king ? 'k' : 0;
+                if (piece) {
+                    if (empty) fen += char('0' + empty);
+                    fen += piece;
+                    empty = 0;
+                } else {
+                    empty++;
+                }
+            }
+            if (empty) fen += char('0' + empty);
+            if (rank) fen += '/';
+        }
+
+        return fen + (side == WHITE ? " w - - 0 1" : " b - - 0 1");
+    }
+}
+
+TEST_CASE("KPK bitbase") {
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+
+    auto start = std::chrono::steady_clock::now();
+    eg_init();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    CHECK(elapsed.count() < 50);
+
+    const std::vector<std::pair<std::string, bool>> draws = {
+            {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", false},
+            {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", false},
+            {"8/8/8/8/4p3/4k3/8/4K3 w - - 0 1", false},
+            {"4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", true}, // Stalemate
+            {"8/8/8/8/8/4k3/4p3/4K3 w - - 0 1", true},
+            {"7k/8/7K/7P/8/8/8/8 w - - 0 1", true}, // Rook pawn
+            {"8/8/8/8/8/k7/p7/K7 b - - 0 1", true},
+            {"8/8/8/8/8/k7/7P/K7 b - - 0 1", false}, // Outside the square
+            {"8/8/8/8/3k4/8/7P/K7 b - - 0 1", true}
+    };
+
+    for (const auto &[fen, draw] : draws) {
+        board_t board(fen);
+        INFO(fen);
+        REQUIRE(eg_kpk_draw(board) == draw);
+    }
+
+    // Wins are scored for the side with the pawn
+    processed_params_t params(eval_params_t{});
+    evaluator_t evaluator(params, 1 * MB);
+    REQUIRE(evaluator.evaluate(board_t("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1")) > 0);
+    REQUIRE(evaluator.evaluate(board_t("8/8/8/8/4p3/4k3/8/4K3 w - - 0 1")) < 0);
+    REQUIRE(evaluator.evaluate(board_t("7k/8/7K/7P/8/8/8/8 w - - 0 1")) == 0);
+}
+
+TEST_CASE("KPK bitbase against Syzygy") {
+    const char *path = std::getenv("TOPPLE_SYZYGY_PATH");
+    if (!path) {
+        WARN("TOPPLE_SYZYGY_PATH is not set, skipping");
+        return;
+    }
+
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+    eg_init();
+    init_tablebases(path);
+    if (TBlargest < 3) {
+        WARN("3 piece tablebases not found in TOPPLE_SYZYGY_PATH, skipping");
+        return;
+    }
+
+    for (uint8_t pawn = A2; pawn <= H7; pawn++) {
+        for (uint8_t w_king = 0; w_king < 64; w_king++) {
+            for (uint8_t b_king = 0; b_king < 64; b_king++) {
+                if (w_king == pawn || b_king == pawn || distance(w_king, b_king) <= 1) continue;
+
+                for (Team side : {WHITE, BLACK}) {
+                    // The side not to move may not be in check
+                    if (side == WHITE && (bb_normal_moves::pawn_caps[WHITE][pawn] & single_bit(b_king))) continue;
+
+                    board_t board(kpk_fen(w_king, pawn, b_king, side));
+                    int success;
+                    int wdl = probe_wdl(board, &success);
+                    REQUIRE(success);
+
+                    bool win = side == WHITE ? wdl > 0 : wdl < 0;
+                    if (eg_kpk_win(WHITE, w_king, pawn, b_king, side) != win) {
+                        FAIL(kpk_fen(w_king, pawn, b_king, side));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Endgame dispatch") {
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+    eg_init();
+
+    auto material = [](const std::string &fen) { return board_t(fen).record.back().material; };
+
+    SECTION("Specialised evaluations") {
+        REQUIRE(eg_evaluator(material("8/8/4k3/8/8/8/8/2BNK3 w - - 0 1")) == eval_kbnk_win<WHITE>);
+        REQUIRE(eg_evaluator(material("8/8/4k3/8/8/8/8/R3K3 w - - 0 1")) == eval_mating_win<WHITE>);
+        REQUIRE(eg_evaluator(material("3qk3/8/8/8/8/8/8/4K3 w - - 0 1")) == eval_mating_win<BLACK>);
+        REQUIRE(eg_evaluator(material("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1")) == eval_kpk<WHITE>);
+        REQUIRE(eg_evaluator(material("8/8/8/8/4p3/4k3/8/4K3 w - - 0 1")) == eval_kpk<BLACK>);
+        REQUIRE(eg_evaluator(material("8/5k2/8/3KB3/8/8/8/8 b - - 0 1")) == eval_draw);
+
+        // Pawn endings beyond KPK use the normal evaluation
+        REQUIRE(eg_evaluator(material("8/8/1p1k4/1P6/2K5/8/8/8 w - - 0 1")) == nullptr);
+        REQUIRE(eg_evaluator(material("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")) == nullptr);
+    }
+
+    SECTION("Scale factors") {
+        REQUIRE(eg_scale(material("4k3/8/8/8/8/8/8/2B1K3 w - - 0 1"), WHITE) == 0); // KBK
+        REQUIRE(eg_scale(material("2b1k3/8/8/8/8/8/8/R3K3 w - - 0 1"), WHITE) == 4); // KRKB
+        REQUIRE(eg_scale(material("4k2r/8/8/8/8/8/8/R1B1K3 w - - 0 1"), WHITE) == 14); // KRBKR
+        REQUIRE(eg_scale(material("4k2r/8/8/8/8/8/P7/R3K3 w - - 0 1"), WHITE) == 48); // KRPKR
+        REQUIRE(eg_scale(material("4k3/8/8/8/8/8/8/3QK3 w - - 0 1"), WHITE) == SCALE_NORMAL);
+    }
+
+    SECTION("Material table reuse") {
+        processed_params_t params(eval_params_t{});
+        evaluator_t evaluator(params, 1 * MB);
+
+        // These material balances share a slot of the material table
+        board_t rook("4k3/8/8/8/8/8/8/R3K3 w - - 0 1");
+        board_t other("1n2k3/8/8/8/8/8/PPP5/1N2K3 w - - 0 1");
+        int rook_eval = evaluator.evaluate(rook);
+        int other_eval = evaluator.evaluate(other);
+
+        // A balance is found again until another one replaces it
+        evaluator.reset_stats();
+        REQUIRE(evaluator.evaluate(other) == other_eval);
+        REQUIRE(evaluator.get_stats().material_hits == 1);
+        REQUIRE(evaluator.evaluate(rook) == rook_eval);
+        REQUIRE(evaluator.get_stats().material_hits == 1);
+        REQUIRE(evaluator.evaluate(other) == other_eval);
+        REQUIRE(evaluator.get_stats().material_hits == 1);
+        REQUIRE(evaluator.get_stats().material_probes == 3);
+    }
+}
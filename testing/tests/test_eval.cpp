@@ -0,0 +1,114 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../catch.hpp"
+#include "../../eval.h"
+#include "../../endgame.h"
+#include "../../hash.h"
+
+TEST_CASE("Packed score tapering") {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> score_dist(-8000, 8000);
+    std::uniform_int_distribution<int> phase_dist(0, TAPER_SCALE);
+
+    for (uint8_t scale : {uint8_t(0), uint8_t(4), uint8_t(14), uint8_t(48), uint8_t(SCALE_NORMAL)}) {
+        for (int i = 0; i < 10000; i++) {
+            v4hi_t score = {int16_t(score_dist(rng)), int16_t(score_dist(rng)),
+                            int16_t(score_dist(rng)), int16_t(score_dist(rng))};
+            int co_phase = phase_dist(rng);
+            int me_phase = phase_dist(rng);
+            const uint8_t scales[2] = {scale, scale};
+
+            // Floating point reference, which each of the three integer divisions can miss by one
+            float co = float(co_phase) / TAPER_SCALE;
+            float me = float(me_phase) / TAPER_SCALE;
+            float mg = co * score[0] + (1 - co) * score[1];
+            float eg = (co * score[2] + (1 - co) * score[3]) * scale / SCALE_NORMAL;
+            float expected = me * mg + (1 - me) * eg;
+
+            INFO(score[0] << " " << score[1] << " " << score[2] << " " << score[3] << " " << co_phase << " " << me_phase << " " << int(scale));
+            REQUIRE(std::abs(evaluator_t::taper(score, co_phase, me_phase, scales) - expected) <= 3);
+        }
+    }
+}
+
+TEST_CASE("Packed parameters") {
+    eval_params_t raw;
+    processed_params_t params(raw);
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 5; j++) {
+            for (int k = 0; k < 4; k++) {
+                REQUIRE(params.threat_matrix[i][j][k] == raw.threat_matrix[i][j][k]);
+            }
+        }
+    }
+
+    for (int k = 0; k < 4; k++) {
+        REQUIRE(params.pos_bishop_pair[k] == raw.pos_bishop_pair[k]);
+        REQUIRE(params.pst[WHITE][KNIGHT][A1][k] == raw.n_pst[12][k]);
+        REQUIRE(params.pst[BLACK][KNIGHT][A8][k] == raw.n_pst[12][k]);
+    }
+}
+
+TEST_CASE("Compile-time parameters") {
+    processed_params_t params(eval_params_t{});
+    REQUIRE(std::memcmp(DEFAULT_PARAMS.pst, params.pst, sizeof(params.pst)) == 0);
+    REQUIRE(std::memcmp(DEFAULT_PARAMS.kat_table, params.kat_table, sizeof(params.kat_table)) == 0);
+
+    // King safety table against the standard library exponential
+    for (int i = 0; i < 128; i++) {
+        for (int j = 0; j < 4; j++) {
+            INFO(i << " " << j);
+            REQUIRE(DEFAULT_PARAMS.kat_table[i][j] == int(double(params.kat_table_max[j]) /
+                    (1 + std::exp((params.kat_table_translate - i) * double(params.kat_table_scale) / 1024.0))));
+        }
+    }
+}
+
+TEST_CASE("Evaluation regression") {
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+    eg_init();
+
+    // Recorded from the evaluator before scores were packed into 16 bit lanes, which used floating point tapering
+    const std::vector<std::pair<std::string, int>> positions = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0},
+        {"rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2", 0},
+        {"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4", -83},
+        {"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 4 9", 9},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", -72},
+        {"r1bqk2r/pp2npbp/2n1p1p1/2pp4/4PP2/P1NP1N2/BPP3PP/R1BQK2R b KQkq - 1 8", 59},
+        {"2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PN1PN2/PB2BPPP/2RQ1RK1 w - - 0 11", 28},
+        {"r2q1rk1/1b2bppp/p2p1n2/np2p3/3PP3/5N1P/PPB2PP1/RNBQR1K1 b - - 0 13", -3},
+        {"4r1k1/pp3ppp/2p5/3p4/3P1q2/2P2Q2/PP3PPP/4R1K1 w - - 0 25", -24},
+        {"6k1/5ppp/8/8/8/8/5PPP/6K1 w - - 0 40", 0},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", -51},
+        {"8/8/4k3/8/2p5/8/B2K4/8 w - - 0 1", 13},
+        {"8/5k2/8/3KB3/8/8/8/8 b - - 0 1", 0},
+        {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", 1140},
+        {"8/8/1p1k4/1P6/2K5/8/8/8 w - - 0 1", 3},
+        {"5rk1/1pp2ppp/p7/8/2B5/1P3P2/P1P3PP/5RK1 b - - 0 22", -462},
+        {"r4rk1/pp1n1ppp/2p1p3/q7/3P4/2PQ1N2/P4PPP/R4RK1 w - - 0 16", -96},
+        {"3r2k1/pp3ppp/4p3/8/8/1P2P3/P4PPP/3R2K1 w - - 0 28", 5},
+        {"1r2r1k1/2P2ppp/8/8/8/8/5PPP/2R1R1K1 w - - 0 1", 287},
+        {"n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1", -7},
+        {"rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", -3},
+        {"2kr3r/ppp2ppp/2n5/2b1p3/4P1q1/2NP4/PPPQ1PPP/R3KB1R w KQ - 0 12", -18},
+        {"8/6k1/6p1/4q3/8/6Q1/5PK1/8 b - - 0 50", 13},
+        {"8/8/8/3k4/8/3K4/3R4/8 w - - 0 1", 1548},
+        {"r5k1/5ppp/8/8/8/8/5PPP/4R1K1 b - - 0 30", 14},
+        {"3k4/8/8/8/8/8/2QK4/8 b - - 0 1", -1999}
+    };
+
+    processed_params_t params(eval_params_t{});
+    evaluator_t evaluator(params, 1 * MB);
+    for (const auto &[fen, expected] : positions) {
+        INFO(fen);
+        REQUIRE(std::abs(evaluator.evaluate(board_t(fen)) - expected) <= 2);
+    }
+}
@@ -25,7 +25,7 @@ TEST_CASE("Hash entry") {
     entry.data = dist(gen);
     entry.coded_hash = hash ^ entry.data;
     
-    packed_move_t move = entry.info.move;
+    move_t move = entry.info.move;
     int16_t internal_value = entry.info.internal_value;
     int16_t static_eval = entry.info.static_eval;
     int depth = entry.depth();
@@ -35,11 +35,79 @@ TEST_CASE("Hash entry") {
     
     REQUIRE((entry.coded_hash ^ entry.data) == hash);
     REQUIRE(entry.generation() == 0);
-    REQUIRE(entry.info.move.from == move.from);
-    REQUIRE(entry.info.move.to == move.to);
-    REQUIRE(entry.info.move.type == move.type);
+    REQUIRE(entry.info.move == move);
     REQUIRE(entry.info.internal_value == internal_value);
     REQUIRE(entry.info.static_eval == static_eval);
     REQUIRE(entry.depth() == depth);
     REQUIRE(entry.bound() == bound);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Key after move") {
+    init_tables();
+    zobrist::init_hashes();
+
+    const std::vector<std::string> fens = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", // Castling
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", // En passant
+            "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1" // Promotions
+    };
+
+    std::mt19937 rng(3);
+    for (const std::string &fen : fens) {
+        board_t board(fen);
+
+        // Random playout, predicting the hashes of every pseudo-legal move and the null move on the way
+        for (int step = 0; step < 100; step++) {
+            move_t moves[257];
+            int count = movegen_t(board).gen_normal(moves);
+            moves[count] = EMPTY_MOVE;
+
+            for (int i = 0; i <= count; i++) {
+                U64 key = board.key_after(moves[i]);
+                U64 pawn_key = board.pawn_key_after(moves[i]);
+
+                board.move(moves[i]);
+                INFO(fen << " " << step << " " << moves[i]);
+                REQUIRE(key == board.record.back().hash);
+                REQUIRE(pawn_key == board.record.back().pawn_hash);
+                board.unmove();
+            }
+
+            bool moved = false;
+            for (int tries = 0; tries < count && !moved; tries++) {
+                board.move(moves[rng() % count]);
+                if (board.is_illegal()) {
+                    board.unmove();
+                } else {
+                    moved = true;
+                }
+            }
+            if (!moved) break;
+        }
+    }
+}
+
+TEST_CASE("Imported entries are checked") {
+    tt::hash_t table(1 * MB);
+    U64 hash = 0x123456789abcdefULL;
+
+    auto make_entry = [hash](tt::Bound bound, int depth, int16_t value) {
+        tt::entry_t entry = {};
+        entry.info.internal_value = value;
+        entry.info.about = uint16_t(bound | (depth << 2));
+        entry.coded_hash = hash ^ entry.data;
+        return entry;
+    };
+
+    tt::entry_t probed = {};
+    REQUIRE_FALSE(table.import(make_entry(tt::NONE, 10, 0)));
+    REQUIRE_FALSE(table.import(make_entry(tt::EXACT, MAX_PLY, 0)));
+    REQUIRE_FALSE(table.import(make_entry(tt::EXACT, 10, -32768)));
+    REQUIRE_FALSE(table.probe(hash, probed));
+
+    REQUIRE(table.import(make_entry(tt::LOWER, 10, 50)));
+    REQUIRE(table.probe(hash, probed));
+    REQUIRE(probed.depth() == 10);
+    REQUIRE(probed.info.internal_value == 50);
+}
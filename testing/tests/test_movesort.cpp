@@ -0,0 +1,155 @@
+#include <memory>
+#include <random>
+
+#include "../catch.hpp"
+#include "../util.h"
+#include "../../board.h"
+#include "../../attacks.h"
+#include "../../movesort.h"
+
+namespace {
+    const std::vector<std::string> movesort_positions = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "r1bqk2r/pp2npbp/2n1p1p1/2pp4/4PP2/P1NP1N2/BPP3PP/R1BQK2R b KQkq - 1 8",
+            "1r2r1k1/2P2ppp/8/8/8/8/5PPP/2R1R1K1 w - - 0 1",
+            "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"
+    };
+}
+
+TEST_CASE("Staged move ordering") {
+    init_tables();
+
+    // Random history, so that the quiets have scores on both sides of the sorting limit
+    auto heur = std::make_unique<heuristic_set_t>();
+    std::mt19937 rng(42);
+    for (const std::string &fen : movesort_positions) {
+        board_t board(fen);
+        move_t moves[256];
+        int count = movegen_t(board).gen_normal(moves);
+        for (int i = 0; i < count; i++) {
+            heur->history.update(board.record.back().next_move, moves[i], int(rng() % 1024) - 512);
+        }
+    }
+
+    for (const std::string &fen : movesort_positions) {
+        board_t board(fen);
+        move_t moves[256];
+        int count = movegen_t(board).gen_normal(moves);
+
+        for (int depth : {1, 4, 12}) {
+            attack_map_t attacks;
+            movesort_t gen(*heur, board, attacks, moves[count - 1], EMPTY_MOVE, 2, depth);
+
+            std::vector<move_t> picked;
+            GenStage stage = GEN_NONE;
+            int score;
+            int last_noisy = INF, last_quiet = INF;
+            bool unsorted = false;
+            for (move_t move = gen.next(stage, score, false); move != EMPTY_MOVE; move = gen.next(stage, score, false)) {
+                INFO(fen << " " << depth << " " << move);
+                picked.push_back(move);
+
+                if (stage == GEN_GOOD_NOISY) {
+                    // Most valuable victim, then least valuable attacker
+                    int victim = (board.is_capture(move) ? VAL[board.captured_piece(move)] : 0)
+                                 + (is_promotion(move) ? VAL[move.info.promotion_type] - VAL[PAWN] : 0);
+                    int value = victim * 8 - board.moving_piece(move);
+                    REQUIRE(value <= last_noisy);
+                    last_noisy = value;
+                } else if (stage == GEN_QUIETS) {
+                    // Sorted down to the limit, and unsorted below it
+                    if (score < -2048 * depth) {
+                        unsorted = true;
+                    } else {
+                        REQUIRE(!unsorted);
+                        REQUIRE(score <= last_quiet);
+                        last_quiet = score;
+                    }
+                }
+            }
+
+            // Every move is picked exactly once, including the hash move
+            REQUIRE(picked.size() == size_t(count));
+            for (int i = 0; i < count; i++) {
+                INFO(fen << " " << moves[i]);
+                REQUIRE(std::count(picked.begin(), picked.end(), moves[i]) == 1);
+            }
+        }
+    }
+}
+
+TEST_CASE("Quiescence move ordering") {
+    init_tables();
+
+    // Captures and promotions that do not lose material, in MVV-LVA order, with their exchange values
+    const std::vector<std::vector<std::pair<std::string, int>>> expected = {
+            {},
+            {{"e2a6", 300}, {"g2h3", 100}, {"d5e6", 0}},
+            {{"g7c3", 0}, {"d5e4", 0}},
+            {{"c7b8q", 400}, {"c7b8r", 400}, {"c7b8b", 400}, {"c7b8n", 400}, {"e1e8", 0}},
+            {{"g2f1q", 200}, {"g2h1q", 1100}, {"g2g1q", 800}, {"g2f1r", 200}, {"g2h1r", 700}, {"g2f1b", 200},
+             {"g2f1n", 200}, {"g2h1b", 500}, {"g2h1n", 500}, {"g2g1r", 400}, {"g2g1b", 200}, {"g2g1n", 200},
+             {"a8c7", 100}, {"c8a7", 100}, {"d7c7", 100}}
+    };
+
+    auto heur = std::make_unique<heuristic_set_t>();
+    for (size_t i = 0; i < movesort_positions.size(); i++) {
+        board_t board(movesort_positions[i]);
+        attack_map_t attacks;
+        attacks.update(board);
+
+        qmovesort_t gen(*heur, board, attacks);
+        int score;
+        for (const auto &entry : expected[i]) {
+            INFO(movesort_positions[i] << " " << entry.first);
+            REQUIRE(gen.next(score) == board.parse_move(entry.first));
+            REQUIRE(score == entry.second);
+        }
+        REQUIRE(gen.next(score) == EMPTY_MOVE);
+    }
+}
+
+TEST_CASE("Move ordering benchmark", "[.][benchmark]") {
+    init_tables();
+
+    auto heur = std::make_unique<heuristic_set_t>();
+    std::vector<board_t> boards;
+    for (const std::string &fen : movesort_positions) boards.emplace_back(fen);
+
+    volatile int sink = 0;
+    BENCHMARK("movesort all moves") {
+        for (int i = 0; i < 10000; i++) {
+            for (const board_t &board : boards) {
+                attack_map_t attacks;
+                movesort_t gen(*heur, board, attacks, EMPTY_MOVE, EMPTY_MOVE, 2, 8);
+                GenStage stage = GEN_NONE;
+                int score;
+                while (gen.next(stage, score, false) != EMPTY_MOVE) sink += score;
+            }
+        }
+    }
+
+    BENCHMARK("qmovesort quiescence") {
+        for (int i = 0; i < 10000; i++) {
+            for (const board_t &board : boards) {
+                attack_map_t attacks;
+                qmovesort_t gen(*heur, board, attacks);
+                int score;
+                while (gen.next(score) != EMPTY_MOVE) sink += score;
+            }
+        }
+    }
+
+    BENCHMARK("movesort first move") {
+        for (int i = 0; i < 10000; i++) {
+            for (const board_t &board : boards) {
+                attack_map_t attacks;
+                movesort_t gen(*heur, board, attacks, EMPTY_MOVE, EMPTY_MOVE, 2, 8);
+                GenStage stage = GEN_NONE;
+                int score;
+                sink += gen.next(stage, score, false).hash;
+            }
+        }
+    }
+}
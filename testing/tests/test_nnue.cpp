@@ -0,0 +1,114 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "../catch.hpp"
+#include "../util.h"
+#include "../../board.h"
+#include "../../eval.h"
+#include "../../movegen.h"
+#include "../../nnue.h"
+
+namespace {
+    // Write a network with random weights in the supported format
+    std::string write_random_network(size_t truncate = 0) {
+        std::mt19937 rng(42);
+        std::string buf;
+
+        auto write = [&](uint64_t value, size_t size) {
+            for (size_t i = 0; i < size; i++) buf += char((value >> (8 * i)) & 0xFFu);
+        };
+        auto write_random = [&](size_t count, size_t size, int min, int max) {
+            std::uniform_int_distribution<int> dist(min, max);
+            for (size_t i = 0; i < count; i++) write(uint64_t(int64_t(dist(rng))), size);
+        };
+
+        const std::string description = "random test network";
+        write(nnue::VERSION, 4);
+        write(0, 4);
+        write(description.size(), 4);
+        buf += description;
+
+        write(0, 4);
+        write_random(nnue::HALF_DIMENSIONS, 2, -64, 64);
+        write_random(nnue::INPUT_DIMENSIONS * nnue::HALF_DIMENSIONS, 2, -16, 16);
+
+        write(0, 4);
+        write_random(nnue::L2, 4, -2000, 2000);
+        write_random(nnue::L2 * nnue::L1, 1, -128, 127);
+        write_random(nnue::L3, 4, -2000, 2000);
+        write_random(nnue::L3 * nnue::L2, 1, -128, 127);
+        write_random(1, 4, -2000, 2000);
+        write_random(nnue::L3, 1, -128, 127);
+
+        std::string path = (std::filesystem::temp_directory_path() / "topple_test.nnue").string();
+        std::ofstream stream(path, std::ios::binary);
+        stream.write(buf.data(), buf.size() - truncate);
+        return path;
+    }
+}
+
+TEST_CASE("NNUE incremental accumulator") {
+    init_tables();
+    zobrist::init_hashes();
+    evaluator_t::eval_init();
+
+    REQUIRE_THROWS(nnue::network_t(write_random_network(1)));
+    std::string path = write_random_network();
+    nnue::network_t network(path);
+    std::filesystem::remove(path);
+    REQUIRE(network.get_description() == "random test network");
+
+    const std::vector<std::string> fens = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", // Castling
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", // En passant
+            "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1" // Promotions
+    };
+
+    std::mt19937 rng(7);
+    for (const std::string &fen : fens) {
+        board_t board(fen);
+        nnue::accumulator_stack_t stack;
+
+        // Random walk, sometimes taking moves back, so that stale accumulators are left above the record
+        for (int step = 0; step < 400; step++) {
+            move_t moves[256];
+            int count = movegen_t(board).gen_normal(moves);
+            bool moved = false;
+            if (rng() % 10 == 0 && !board.is_incheck()) {
+                board.move(EMPTY_MOVE); // Null move
+                moved = true;
+            }
+            for (int tries = 0; tries < count && !moved; tries++) {
+                board.move(moves[rng() % count]);
+                if (board.is_illegal()) {
+                    board.unmove();
+                } else {
+                    moved = true;
+                }
+            }
+
+            if (!moved || board.record.size() > 40 || rng() % 4 == 0) {
+                if (board.record.size() <= 1) break;
+                board.unmove();
+                if (board.record.size() > 1 && rng() % 2) board.unmove();
+            }
+
+            int eval = network.evaluate(board, stack);
+
+            nnue::accumulator_t fresh;
+            network.refresh(board, fresh, WHITE);
+            network.refresh(board, fresh, BLACK);
+
+            INFO(fen << " " << board.record.size());
+            const nnue::accumulator_t &acc = stack[board.record.size() - 1];
+            REQUIRE(std::memcmp(acc.values, fresh.values, sizeof(fresh.values)) == 0);
+
+            Team side = board.record.back().next_move;
+            REQUIRE(network.propagate(acc, side) == network.propagate_reference(acc, side));
+            REQUIRE(eval == network.propagate_reference(fresh, side) * 100 / nnue::PAWN_VALUE);
+        }
+    }
+}
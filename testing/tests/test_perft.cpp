@@ -2,6 +2,8 @@
 // Created by Vincent on 30/09/2017.
 //
 
+#include <sstream>
+
 #include "../catch.hpp"
 #include "../util.h"
 #include "../../board.h"
@@ -83,7 +85,9 @@ U64 perft(board_t &board, int depth) {
     while ((next = buf[idx++]) != EMPTY_MOVE) {
         //INFO(next);
         REQUIRE(board.is_pseudo_legal(next));
-        REQUIRE(board.to_move(compress(next)) == next);
+        std::ostringstream uci;
+        uci << next;
+        REQUIRE(board.parse_move(uci.str()) == next);
 
         bool is_legal = board.is_legal(next);
         bool gives_check = board.gives_check(next);
@@ -104,7 +108,7 @@ U64 perft(board_t &board, int depth) {
 
         if(board != snapshot 
             || board.record.back().hash != snapshot.record.back().hash
-            || board.record.back().kp_hash != snapshot.record.back().kp_hash) {
+            || board.record.back().pawn_hash != snapshot.record.back().pawn_hash) {
             FAIL("Unmake move failed at position: " << board
                                                     << "expecting " << snapshot
                                                     << " move=" << from_sq(next.info.from) << from_sq(next.info.to));
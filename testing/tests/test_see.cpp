@@ -6,6 +6,7 @@
 #include "../catch.hpp"
 #include "../util.h"
 #include "../../board.h"
+#include "../../movegen.h"
 
 TEST_CASE("Static Exchange Evaluation") {
     REQUIRE_NOTHROW(init_tables());
@@ -50,4 +51,61 @@ TEST_CASE("Static Exchange Evaluation") {
         REQUIRE(board.see(board.parse_move("e3e4")) == 0);
         REQUIRE(board.see(board.parse_move("d1d4")) == (VAL[PAWN] - VAL[QUEEN]));
     }
-}
\ No newline at end of file
+}
+
+namespace {
+    const std::vector<std::string> see_positions = {
+            "rnbqkb1r/pppp1ppp/5n2/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+            "r1bqkb1r/ppp2ppp/2n2n2/3pp1N1/2B1P3/8/PPPP1PPP/RNBQK2R w KQkq - 0 5",
+            "r1bqk2r/pp2npbp/2n1p1p1/2pp4/4PP2/P1NP1N2/BPP3PP/R1BQK2R b KQkq - 1 8",
+            "rn1q1rk1/1b1pppbp/p4np1/1PpP4/P1B5/2N1P3/1P2NPPP/R1BQK2R b KQ - 4 9",
+            "1r2r1k1/2P2ppp/8/8/8/8/5PPP/2R1R1K1 w - - 0 1" // Promotions
+    };
+}
+
+TEST_CASE("Threshold Static Exchange Evaluation") {
+    REQUIRE_NOTHROW(init_tables());
+
+    for (const std::string &fen : see_positions) {
+        board_t board(fen);
+        move_t moves[256];
+        int count = movegen_t(board).gen_normal(moves);
+
+        for (int i = 0; i < count; i++) {
+            int see = board.see(moves[i]);
+            for (int threshold : {see - 1, see, see + 1, -VAL[QUEEN], -VAL[PAWN], 0, VAL[PAWN], VAL[QUEEN]}) {
+                INFO(fen << " " << moves[i] << " " << threshold);
+                REQUIRE(board.see_ge(moves[i], threshold) == (see >= threshold));
+            }
+        }
+    }
+}
+
+TEST_CASE("Static Exchange Evaluation benchmark", "[.][benchmark]") {
+    init_tables();
+
+    std::vector<std::pair<board_t, std::vector<move_t>>> positions;
+    for (const std::string &fen : see_positions) {
+        board_t board(fen);
+        move_t moves[256];
+        int count = movegen_t(board).gen_normal(moves);
+        positions.emplace_back(board, std::vector<move_t>(moves, moves + count));
+    }
+
+    volatile int sink = 0;
+    BENCHMARK("see >= 0") {
+        for (int i = 0; i < 10000; i++) {
+            for (const auto &[board, moves] : positions) {
+                for (move_t move : moves) sink += board.see(move) >= 0;
+            }
+        }
+    }
+
+    BENCHMARK("see_ge 0") {
+        for (int i = 0; i < 10000; i++) {
+            for (const auto &[board, moves] : positions) {
+                for (move_t move : moves) sink += board.see_ge(move, 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#include <atomic>
+#include <future>
+#include <chrono>
+
+#include "../catch.hpp"
+#include "../../uci.h"
+
+TEST_CASE("Thread budget") {
+    uci::budget_t budget(4, 64);
+    std::atomic_bool cancel = false;
+
+    SECTION("Requests are granted from what is left") {
+        REQUIRE(budget.acquire_threads(3, cancel) == 3);
+        REQUIRE(budget.acquire_threads(3, cancel) == 1);
+        budget.release_threads(4);
+    }
+
+    SECTION("An exhausted budget makes the search wait") {
+        REQUIRE(budget.acquire_threads(4, cancel) == 4);
+
+        auto waiting = std::async(std::launch::async, [&] { return budget.acquire_threads(2, cancel); });
+        REQUIRE(waiting.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+
+        budget.release_threads(1);
+        REQUIRE(waiting.get() == 1);
+        budget.release_threads(4);
+    }
+
+    SECTION("Waiting for an exhausted budget can be cancelled") {
+        REQUIRE(budget.acquire_threads(4, cancel) == 4);
+
+        auto waiting = std::async(std::launch::async, [&] { return budget.acquire_threads(1, cancel); });
+        cancel = true;
+        REQUIRE(waiting.get() == 0);
+
+        // Nothing was taken by the cancelled request
+        budget.release_threads(4);
+        cancel = false;
+        REQUIRE(budget.acquire_threads(4, cancel) == 4);
+        budget.release_threads(4);
+    }
+}
@@ -0,0 +1,172 @@
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <cstring>
+#include <climits>
+
+#include "topple.h"
+#include "board.h"
+#include "search.h"
+#include "endgame.h"
+
+struct topple_engine {
+    topple_engine(size_t hash_mb, int threads) : hash_mb(hash_mb), threads(threads),
+            tt(std::make_unique<tt::hash_t>(hash_mb * MB)), params(eval_params_t()),
+            search(std::make_unique<search_t>(tt.get(), params, threads)) {}
+
+    size_t hash_mb;
+    int threads;
+
+    std::unique_ptr<tt::hash_t> tt;
+    processed_params_t params;
+    std::unique_ptr<search_t> search;
+    std::unique_ptr<board_t> board;
+    std::atomic_bool aborted{false};
+
+    search_result_t result = {EMPTY_MOVE, EMPTY_MOVE};
+    bool has_result = false;
+};
+
+namespace {
+    std::once_flag init_flag;
+
+    std::string move_list(const std::vector<move_t> &moves) {
+        std::ostringstream oss;
+        for (size_t i = 0; i < moves.size(); i++) {
+            if (i) oss << " ";
+            oss << moves[i];
+        }
+        return oss.str();
+    }
+
+    size_t copy_string(const std::string &str, char *buf, size_t size) {
+        if (buf && size > 0) {
+            size_t len = std::min(str.size(), size - 1);
+            std::memcpy(buf, str.data(), len);
+            buf[len] = '\0';
+        }
+        return str.size();
+    }
+
+    int to_mate(int score) {
+        if (score > MINCHECKMATE) return (TO_MATE_PLY(score) + 1) / 2;
+        if (score < -MINCHECKMATE) return -((TO_MATE_PLY(-score) + 1) / 2);
+        return 0;
+    }
+}
+
+topple_engine *topple_create(size_t hash_mb, int threads) {
+    std::call_once(init_flag, [] {
+        init_tables();
+        zobrist::init_hashes();
+        evaluator_t::eval_init();
+        eg_init();
+    });
+
+    try {
+        return new topple_engine(std::max<size_t>(hash_mb, 1), std::max(threads, 1));
+    } catch (std::exception &) {
+        return nullptr;
+    }
+}
+
+void topple_destroy(topple_engine *engine) {
+    delete engine;
+}
+
+void topple_new_game(topple_engine *engine) {
+    engine->search.reset();
+    engine->tt = std::make_unique<tt::hash_t>(engine->hash_mb * MB);
+    engine->search = std::make_unique<search_t>(engine->tt.get(), engine->params, engine->threads);
+}
+
+int topple_set_position(topple_engine *engine, const char *fen, const char *moves) {
+    std::unique_ptr<board_t> board;
+    try {
+        board = std::make_unique<board_t>(fen ? fen : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    } catch (std::exception &) {
+        return -1;
+    }
+
+    if (moves) {
+        std::istringstream iss(moves);
+        std::string move_str;
+        while (iss >> move_str) {
+            move_t move = board->parse_move(move_str);
+            if (!board->is_pseudo_legal(move) || !board->is_legal(move)) return -1;
+            board->move(move);
+        }
+    }
+
+    // Arm the next search here, so that a stop arriving before the search starts is not lost
+    engine->board = std::move(board);
+    engine->has_result = false;
+    engine->aborted = false;
+    return 0;
+}
+
+int topple_search(topple_engine *engine, const topple_limits *limits, topple_info_callback callback,
+                  void *user_data) {
+    engine->has_result = false;
+    if (!engine->board) return -1;
+
+    search_limits_t search_limits(limits && limits->movetime > 0 ? limits->movetime : INT_MAX,
+                                  limits && limits->depth > 0 ? limits->depth : MAX_PLY,
+                                  limits && limits->nodes > 0 ? limits->nodes : UINT64_MAX,
+                                  std::vector<move_t>());
+
+    if (callback) {
+        engine->search->set_info_callback([callback, user_data](const search_info_t &info) {
+            std::string pv = move_list(info.pv);
+            topple_info c_info = {};
+            c_info.depth = info.depth;
+            c_info.seldepth = int(info.sel_depth);
+            c_info.score = info.score;
+            c_info.mate = to_mate(info.score);
+            c_info.bound = info.bound == tt::UPPER ? TOPPLE_BOUND_UPPER
+                         : info.bound == tt::LOWER ? TOPPLE_BOUND_LOWER : TOPPLE_BOUND_EXACT;
+            c_info.nodes = info.nodes;
+            c_info.time = info.time;
+            c_info.pv = pv.c_str();
+            callback(&c_info, user_data);
+        });
+    } else {
+        // No callback: discard progress rather than writing UCI output
+        engine->search->set_info_callback([](const search_info_t &) {});
+    }
+
+    engine->search->enable_timer();
+    engine->result = engine->search->think(*engine->board, search_limits, engine->aborted);
+    engine->search->reset_timer();
+    engine->aborted = false; // A stop is used up by the search it ended
+    engine->tt->age();
+
+    engine->has_result = engine->result.best_move != EMPTY_MOVE;
+    return engine->has_result ? 0 : -1;
+}
+
+void topple_stop(topple_engine *engine) {
+    engine->aborted = true;
+}
+
+size_t topple_best_move(const topple_engine *engine, char *buf, size_t size) {
+    if (!engine->has_result) return copy_string("", buf, size);
+
+    std::ostringstream oss;
+    oss << engine->result.best_move;
+    return copy_string(oss.str(), buf, size);
+}
+
+size_t topple_pv(const topple_engine *engine, char *buf, size_t size) {
+    if (!engine->has_result) return copy_string("", buf, size);
+
+    std::vector<move_t> pv = engine->result.pv;
+    while (!pv.empty() && pv.back() == EMPTY_MOVE) pv.pop_back();
+    return copy_string(move_list(pv), buf, size);
+}
+
+int topple_score(const topple_engine *engine, int *mate) {
+    int score = engine->has_result ? engine->result.score : 0;
+    if (mate) *mate = to_mate(score);
+    return score;
+}
@@ -0,0 +1,95 @@
+/*
+ * Topple embedding API
+ *
+ * A stable C interface to the Topple engine, for running searches in-process without the UCI protocol. Each engine
+ * instance owns its own transposition table and search threads. An engine instance must not be used from more than
+ * one thread at a time, with the exception of topple_stop().
+ */
+
+#ifndef TOPPLE_H
+#define TOPPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Only the functions of this API are exported from the shared library */
+#if defined(__GNUC__)
+#define TOPPLE_API __attribute__((visibility("default")))
+#else
+#define TOPPLE_API
+#endif
+
+typedef struct topple_engine topple_engine;
+
+/* Search limits. Zero means no limit for every field. */
+typedef struct topple_limits {
+    int depth;
+    uint64_t nodes;
+    int movetime; /* milliseconds */
+} topple_limits;
+
+/* Bounds of a search score */
+enum {
+    TOPPLE_BOUND_EXACT = 0,
+    TOPPLE_BOUND_UPPER = 1,
+    TOPPLE_BOUND_LOWER = 2
+};
+
+/* Progress of a search, passed to the info callback. The pv string is only valid during the callback. */
+typedef struct topple_info {
+    int depth;
+    int seldepth;
+    int score; /* centipawns, relative to the side to move */
+    int mate; /* moves to mate, negative if getting mated, or 0 */
+    int bound;
+    uint64_t nodes;
+    uint64_t time; /* milliseconds */
+    const char *pv; /* space separated moves in UCI notation */
+} topple_info;
+
+/* Called from a search thread as the search progresses. Calls are never concurrent. */
+typedef void (*topple_info_callback)(const topple_info *info, void *user_data);
+
+/* Create an engine with a hash table of hash_mb MiB and the given number of search threads, or NULL on failure. */
+TOPPLE_API topple_engine *topple_create(size_t hash_mb, int threads);
+
+/* Destroy an engine. No search may be in progress. */
+TOPPLE_API void topple_destroy(topple_engine *engine);
+
+/* Clear the hash table, for example before an unrelated position. */
+TOPPLE_API void topple_new_game(topple_engine *engine);
+
+/*
+ * Set the position from a FEN string (or the start position if fen is NULL), followed by an optional space separated
+ * list of moves in UCI notation. Returns 0 on success, or -1 if the FEN or a move is invalid, in which case the
+ * previous position is kept. Setting the position clears any earlier topple_stop().
+ */
+TOPPLE_API int topple_set_position(topple_engine *engine, const char *fen, const char *moves);
+
+/*
+ * Search the current position until a limit is reached or topple_stop() is called. The callback may be NULL. Returns
+ * 0 on success, or -1 if no move could be found (no position, no legal moves, or stopped before depth 1).
+ */
+TOPPLE_API int topple_search(topple_engine *engine, const topple_limits *limits, topple_info_callback callback, void *user_data);
+
+/* Stop the search in progress, or the next search if none is in progress. May be called from any thread. */
+TOPPLE_API void topple_stop(topple_engine *engine);
+
+/* Write the best move of the last search in UCI notation into buf. Returns the length of the move, or 0 if none. */
+TOPPLE_API size_t topple_best_move(const topple_engine *engine, char *buf, size_t size);
+
+/* Write the space separated PV of the last search into buf. Returns the length of the full PV string. */
+TOPPLE_API size_t topple_pv(const topple_engine *engine, char *buf, size_t size);
+
+/* Score of the last search in centipawns, relative to the side to move. Moves to mate are stored in mate if not NULL. */
+TOPPLE_API int topple_score(const topple_engine *engine, int *mate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOPPLE_H */
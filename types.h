@@ -38,6 +38,13 @@ inline std::ostream& operator<<(std::ostream& os, v4si_t v4si) {
     return os;
 }
 
+// Packed evaluation score: {mgc, mgo, egc, ego} in 16 bit lanes, used by the evaluator
+typedef int16_t v4hi_t __attribute__ ((vector_size (8)));
+inline std::ostream& operator<<(std::ostream& os, v4hi_t v4hi) {
+    os << "{" << v4hi[0] << "," << v4hi[1] << "," << v4hi[2] << "," << v4hi[3] << "}";
+    return os;
+}
+
 enum Piece {
     PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING
 };
@@ -0,0 +1,555 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <climits>
+
+#include "uci.h"
+#include "movegen.h"
+
+#include "syzygy/tbprobe.h"
+
+namespace uci {
+    budget_t::budget_t(size_t threads, size_t hash_mb) : threads_total(threads), hash_total(hash_mb) {}
+
+    size_t budget_t::acquire_threads(size_t requested, const std::atomic_bool &cancel) {
+        std::unique_lock<std::mutex> lock(mtx);
+
+        // Nothing notifies a cancellation, so check it now and then while waiting
+        while (threads_used >= threads_total) {
+            if (cancel) return 0;
+            threads_freed.wait_for(lock, std::chrono::milliseconds(10));
+        }
+
+        size_t granted = std::max<size_t>(1, std::min(requested, threads_total - threads_used));
+        threads_used += granted;
+        return granted;
+    }
+
+    void budget_t::release_threads(size_t count) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            threads_used -= count;
+        }
+        threads_freed.notify_all();
+    }
+
+    size_t budget_t::acquire_hash(size_t requested_mb) {
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t granted = std::max<size_t>(1, std::min(requested_mb, hash_total - std::min(hash_used, hash_total)));
+        hash_used += granted;
+        return granted;
+    }
+
+    void budget_t::release_hash(size_t mb) {
+        std::lock_guard<std::mutex> lock(mtx);
+        hash_used -= mb;
+    }
+
+    session_t::session_t(output::writer_t &out, const processed_params_t &params, budget_t *budget)
+            : out(out), params(params), budget(budget) {
+        resize_hash();
+        create_search(1);
+    }
+
+    session_t::~session_t() {
+        if (search_active) {
+            search->enable_timer();
+            search_abort = true;
+        }
+        if (future.valid()) future.wait();
+
+        search.reset();
+        if (budget) budget->release_hash(hash_granted);
+    }
+
+    void session_t::resize_hash() {
+        std::lock_guard<std::mutex> lock(tt_memory_mtx);
+
+        if (budget) {
+            budget->release_hash(hash_granted);
+            hash_granted = budget->acquire_hash(hash_size);
+        } else {
+            hash_granted = hash_size;
+        }
+
+        // Free the old table before allocating the new one
+        tt.reset();
+        tt = std::make_unique<tt::hash_t>(hash_granted * MB);
+    }
+
+    void session_t::create_search(size_t search_threads) {
+        search.reset();
+        search = std::make_unique<search_t>(tt.get(), params, search_threads);
+        search->set_output(out);
+        search->set_book(book, book_depth);
+        search->set_network(network);
+        this->search_threads = search_threads;
+    }
+
+    move_t session_t::unsearched_move() {
+        tt::entry_t h = {};
+        if (tt->probe(board->record.back().hash, h) && board->is_pseudo_legal(h.info.move)
+            && board->is_legal(h.info.move)) {
+            return h.info.move;
+        }
+
+        move_t buf[192];
+        movegen_t gen(*board);
+        int pseudo_legal = gen.gen_normal(buf);
+        for (int i = 0; i < pseudo_legal; i++) {
+            if (board->is_legal(buf[i])) return buf[i];
+        }
+
+        return EMPTY_MOVE;
+    }
+
+    void session_t::use_peer_result(const cluster::peer_result_t &peer, search_result_t &result) {
+        // Take the legal prefix of the peer's PV
+        std::istringstream iss(peer.pv);
+        std::vector<move_t> pv;
+        std::string move_str;
+        while (iss >> move_str) {
+            move_t move = board->parse_move(move_str);
+            if (move == EMPTY_MOVE || !board->is_pseudo_legal(move) || !board->is_legal(move)) break;
+            board->move(move);
+            pv.push_back(move);
+        }
+        for (size_t i = 0; i < pv.size(); i++) board->unmove();
+
+        // The peer must play one of the moves the front searched, which keeps to searchmoves and the tablebases
+        const std::vector<move_t> &root_moves = search->searched_root_moves();
+        if (pv.empty() || std::find(root_moves.begin(), root_moves.end(), pv[0]) == root_moves.end()) return;
+
+        // The whole line comes from the peer, except the node count which stays local
+        result.best_move = pv[0];
+        result.ponder = pv.size() > 1 ? pv[1] : EMPTY_MOVE;
+        result.score = peer.score;
+        result.depth = peer.depth;
+        result.pv = std::move(pv);
+        out.write("info string cluster depth " + std::to_string(peer.depth) + " pv " + peer.pv);
+    }
+
+    bool session_t::handle(const std::string &input) {
+        std::istringstream iss(input);
+
+        std::string cmd;
+        iss >> cmd;
+
+        if (cmd == "uci") {
+            // Print ids
+            out.write("id name Topple " TOPPLE_VER);
+            out.write("id author Vincent Tang");
+
+            // Print options
+            out.write("option name Hash type spin default 128 min 1 max 131072");
+            out.write("option name MoveOverhead type spin default 50 min 0 max 10000");
+            out.write("option name Threads type spin default 1 min 1 max 256");
+            out.write("option name SyzygyPath type string default <empty>");
+            out.write("option name SyzygyResolve type spin default 512 min 1 max 1024");
+            out.write("option name Ponder type check default false");
+            out.write("option name Deterministic type check default false");
+            out.write("option name InfoInterval type spin default 0 min 0 max 10000");
+            out.write("option name ClusterPeers type string default <empty>");
+            out.write("option name BookFile type string default <empty>");
+            out.write("option name BookDepth type spin default 20 min 0 max 255");
+            out.write("option name EvalFile type string default <empty>");
+
+            out.write_now("uciok");
+        } else if (cmd == "setoption") {
+            if (search_active) {
+                std::cerr << "warn: setoption command rejected as search is in progress" << std::endl;
+            } else {
+                std::string name;
+
+                // Read "name <name>", or just "<name>"
+                iss >> name;
+                if (name == "name") iss >> name;
+
+                if (name == "Hash") {
+                    std::string value;
+                    iss >> value; // Skip value
+                    iss >> hash_size;
+
+                    // Resize hash, and recreate search
+                    resize_hash();
+                    create_search(deterministic ? 1 : threads);
+                } else if (name == "MoveOverhead") {
+                    std::string value;
+                    iss >> value;
+                    iss >> move_overhead;
+                } else if (name == "Threads") {
+                    std::string value;
+                    iss >> value; // Skip value
+                    iss >> threads;
+
+                    search_threads = deterministic ? 1 : threads;
+                    search->set_threads(search_threads);
+                } else if (name == "SyzygyPath" && budget) {
+                    std::cerr << "warn: tablebases are shared by all sessions and set when starting the server" << std::endl;
+                } else if (name == "SyzygyPath") {
+                    std::string value;
+                    iss >> value; // Skip value
+
+                    std::getline(iss, tb_path);
+
+                    tb_path = tb_path.substr(1, tb_path.size() - 1);
+
+                    out.write_now("Looking for tablebases in: " + tb_path);
+
+                    init_tablebases(tb_path.c_str());
+                } else if (name == "SyzygyResolve") {
+                    std::string value;
+                    iss >> value; // Skip value
+                    iss >> syzygy_resolve;
+                } else if (name == "Ponder") {
+                    // Do nothing
+                } else if (name == "ClusterPeers") {
+                    std::string value;
+                    iss >> value; // Skip value
+
+                    std::vector<std::string> peers;
+                    std::string peer;
+                    while (iss >> peer) {
+                        if (peer != "<empty>") peers.push_back(peer);
+                    }
+
+                    cluster.reset();
+                    if (!peers.empty()) {
+                        cluster = std::make_unique<cluster::front_t>(peers);
+                        out.write_now("info string connected to " + std::to_string(cluster->connected()) + " of "
+                                      + std::to_string(peers.size()) + " cluster peers");
+                    }
+                } else if (name == "BookFile") {
+                    std::string value, path;
+                    iss >> value; // Skip value
+
+                    std::getline(iss, path);
+                    path = path.empty() ? path : path.substr(1);
+
+                    book.reset();
+                    if (!path.empty() && path != "<empty>") {
+                        try {
+                            book = std::make_shared<book::book_t>(path);
+                            out.write_now("info string loaded " + std::to_string(book->size()) + " book entries");
+                        } catch (std::exception &e) {
+                            std::cerr << "warn: " << e.what() << std::endl;
+                        }
+                    }
+                    search->set_book(book, book_depth);
+                } else if (name == "EvalFile") {
+                    std::string value, path;
+                    iss >> value; // Skip value
+
+                    std::getline(iss, path);
+                    path = path.empty() ? path : path.substr(1);
+
+                    network.reset();
+                    if (!path.empty() && path != "<empty>") {
+                        try {
+                            network = std::make_shared<nnue::network_t>(path);
+                            out.write_now("info string loaded network " + network->get_description());
+                        } catch (std::exception &e) {
+                            std::cerr << "warn: " << e.what() << std::endl;
+                        }
+                    }
+                    search->set_network(network);
+                } else if (name == "BookDepth") {
+                    std::string value;
+                    iss >> value; // Skip value
+                    iss >> book_depth;
+                    search->set_book(book, book_depth);
+                } else if (name == "InfoInterval") {
+                    std::string value;
+                    iss >> value; // Skip value
+                    int interval = 0;
+                    iss >> interval;
+                    out.set_interval(interval);
+                } else if (name == "Deterministic") {
+                    std::string value;
+                    iss >> value; // Skip value
+                    iss >> value;
+                    deterministic = value == "true";
+
+                    // A single search thread makes fixed-node searches reproducible
+                    search_threads = deterministic ? 1 : threads;
+                    search->set_threads(search_threads);
+                } else {
+                    std::cerr << "warn: unrecognised option " << name << std::endl;
+                }
+            }
+        } else if (cmd == "isready") {
+            out.write_now("readyok");
+        } else if (cmd == "stop") {
+            if (search_active) {
+                // Cancel waiting for ponderhit by enabling the search timer, and then hard-aborting.
+                search->enable_timer();
+                search_abort = true;
+
+                // Wait for the search to finish before accepting any other commands.
+                future.wait();
+            } else {
+                std::cerr << "warn: stop command received, but no search was in progress" << std::endl;
+            }
+        } else if (cmd == "position") {
+            std::string fen;
+            std::vector<std::string> moves;
+
+            std::string type;
+            while (iss >> type) {
+                if (type == "startpos") {
+                    fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+                } else if (type == "fen") {
+                    fen.clear();
+                    for (int i = 0; i < 6; i++) {
+                        std::string component;
+                        iss >> component;
+                        fen += component + " ";
+                    }
+                } else if (type == "moves") {
+                    std::string move_str;
+                    while (iss >> move_str) {
+                        moves.push_back(move_str);
+                    }
+                }
+            }
+
+            // Only the new moves are played if the move list extends the previous one from the same position
+            size_t played = 0;
+            if (!fen.empty()) {
+                if (board && fen == position_fen && moves.size() >= position_moves.size()
+                    && std::equal(position_moves.begin(), position_moves.end(), moves.begin())) {
+                    played = position_moves.size();
+                } else {
+                    board = std::make_unique<board_t>(fen);
+                    position_fen = fen;
+                    position_moves.clear();
+                }
+            }
+
+            if (board) {
+                // Read moves
+                for (auto it = moves.begin() + played; it != moves.end(); it++) {
+                    const std::string &move_str = *it;
+                    move_t move = board->parse_move(move_str);
+                    if (board->is_pseudo_legal(move)) {
+                        board->move(move);
+                        if (board->is_illegal()) {
+                            std::cerr << "warn: illegal move " << move_str << std::endl;
+                            board->unmove();
+                        }
+                    } else {
+                        std::cerr << "warn: invalid move " << move_str << std::endl;
+                    }
+                    position_moves.push_back(move_str);
+                }
+            } else if (!moves.empty()) {
+                std::cerr << "warn: no start position specified" << std::endl;
+            }
+        } else if (cmd == "go") {
+            if (search_active) {
+                std::cerr << "warn: go command received, but search already in progress" << std::endl;
+            } else if (board) {
+                // Parse parameters
+                int max_time = INT_MAX;
+                int max_depth = MAX_PLY;
+                U64 max_nodes = UINT64_MAX;
+                bool ponder = false;
+                std::vector<move_t> root_moves;
+
+                struct {
+                    bool enabled = false;
+                    int time = 0;
+                    int inc = 0;
+                    int moves = 0;
+                } time_control;
+
+                std::string param;
+                while (iss >> param) {
+                    if (param == "infinite") {
+                        max_time = INT_MAX;
+                        max_depth = MAX_PLY;
+                    } else if (param == "depth") {
+                        iss >> max_depth;
+                    } else if (param == "movetime") {
+                        iss >> max_time;
+                    } else if (param == "nodes") {
+                        iss >> max_nodes;
+                    } else if (param == "searchmoves") {
+                        std::string move_str;
+                        while (iss >> move_str) {
+                            move_t move = board->parse_move(move_str);
+                            if (move != EMPTY_MOVE) {
+                                root_moves.push_back(move);
+                            } else {
+                                break;
+                            }
+                        }
+                    } else if (param == "wtime") {
+                        time_control.enabled = true;
+                        if (board->record.back().next_move == WHITE) {
+                            iss >> time_control.time;
+                        }
+                    } else if (param == "btime") {
+                        time_control.enabled = true;
+                        if (board->record.back().next_move == BLACK) {
+                            iss >> time_control.time;
+                        }
+                    } else if (param == "winc") {
+                        time_control.enabled = true;
+                        if (board->record.back().next_move == WHITE) {
+                            iss >> time_control.inc;
+                        }
+                    } else if (param == "binc") {
+                        time_control.enabled = true;
+                        if (board->record.back().next_move == BLACK) {
+                            iss >> time_control.inc;
+                        }
+                    } else if (param == "movestogo") {
+                        time_control.enabled = true;
+                        iss >> time_control.moves;
+                    } else if (param == "ponder") {
+                        ponder = true;
+                    }
+                }
+
+                // Setup
+                search_active = true;
+                search_abort = false;
+
+                search_limits_t limits = time_control.enabled ?
+                                         search_limits_t(time_control.time - move_overhead,
+                                                         time_control.inc, time_control.moves) :
+                                         search_limits_t(max_time, max_depth, max_nodes, root_moves);
+
+                limits.syzygy_resolve = syzygy_resolve;
+
+                // Cluster workers search the same position, which they set up from the position command
+                bool clustered = cluster && !position_fen.empty();
+                if (clustered) cluster->start(position_fen, position_moves, limits, tt.get());
+
+                if (!ponder) search->enable_timer();
+
+                // Start search
+                future = std::async(std::launch::async,
+                                    [this, ponder, limits, clustered] {
+                                        // Sessions of a server wait for their share of the thread budget
+                                        size_t requested = deterministic ? 1 : threads;
+                                        size_t granted = budget ? budget->acquire_threads(requested, search_abort)
+                                                                : search_threads;
+                                        if (granted && granted != search_threads) {
+                                            search->set_threads(granted);
+                                            search_threads = granted;
+                                        }
+
+                                        search_result_t result = {EMPTY_MOVE, EMPTY_MOVE};
+                                        if (granted) {
+                                            result = search->think(*board, limits, search_abort);
+                                        } else {
+                                            // Stopped while waiting for threads, so answer without searching
+                                            result.best_move = unsearched_move();
+                                        }
+
+                                        // Play the deepest result, as Lazy SMP does with its helper threads
+                                        if (clustered) {
+                                            cluster::peer_result_t peer = cluster->stop();
+                                            if (granted && peer.depth > result.depth) use_peer_result(peer, result);
+                                        }
+
+                                        std::ostringstream bestmove;
+                                        bestmove << "bestmove " << result.best_move;
+                                        if (result.ponder != EMPTY_MOVE) {
+                                            bestmove << " ponder " << result.ponder;
+                                        }
+                                        out.write_now(bestmove.str());
+
+                                        if (budget) budget->release_threads(granted);
+                                        search_active = false;
+                                        search->reset_timer();
+
+                                        // Age the transposition table
+                                        {
+                                            std::lock_guard<std::mutex> lock(tt_memory_mtx);
+                                            tt->age();
+                                        }
+                                    }
+                );
+            } else {
+                std::cerr << "warn: search command received, but no position specified" << std::endl;
+            }
+        } else if (cmd == "ponderhit") {
+            if (search_active) {
+                search->enable_timer();
+            } else {
+                std::cerr << "warn: ponderhit command received, but no search in progress" << std::endl;
+            }
+        } else if (cmd == "ucinewgame") {
+            if (search_active) {
+                std::cerr << "warn: ucinewgame command received, but search is in progress" << std::endl;
+            } else {
+                // Recreate hash table and search
+                resize_hash();
+                create_search(deterministic ? 1 : threads);
+                if (cluster) cluster->new_game();
+            }
+        } else if (cmd == "mirror") {
+            if (board) {
+                board->mirror();
+                position_fen.clear();
+            } else {
+                std::cerr << "warn: mirror command received, but no position specified" << std::endl;
+            }
+        } else if (cmd == "tbprobe") {
+            std::string type;
+            iss >> type;
+
+            if (board) {
+                const std::string cases[5] = {"loss", "blessed_loss", "draw", "cursed_win", "win"};
+
+                if (type == "dtz") {
+                    int success;
+                    int dtz = probe_dtz(*board, &success);
+
+                    if (success) {
+                        int cnt50 = board->record.back().halfmove_clock;
+                        int wdl = 0;
+                        if (dtz > 0)
+                            wdl = (dtz + cnt50 <= 100) ? 2 : 1;
+                        else if (dtz < 0)
+                            wdl = (-dtz + cnt50 <= 100) ? -2 : -1;
+
+                        out.write_now("syzygy " + cases[wdl + 2] + " dtz " + std::to_string(dtz));
+                    } else {
+                        out.write_now("syzygy failed");
+                    }
+                } else if (type == "wdl") {
+                    int success;
+                    int wdl = probe_wdl(*board, &success);
+
+                    if (success) {
+                        out.write_now("syzygy " + cases[wdl + 2]);
+                    } else {
+                        out.write_now("syzygy failed");
+                    }
+                } else {
+                    std::cerr << "warn: unrecognised table type: dtz or wdl?" << std::endl;
+                }
+            } else {
+                std::cerr << "warn: tbprobe command received, but no position specified" << std::endl;
+            }
+        } else if (cmd == "print") {
+            if (board) {
+                std::ostringstream board_str;
+                board_str << *board;
+                out.write_now(board_str.str());
+            } else {
+                out.write_now("nullptr");
+            }
+        } else if (cmd == "quit" || cmd == "exit") {
+            return false;
+        } else if (!cmd.empty()) {
+            std::cerr << "warn: unrecognised command " << cmd << std::endl;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef TOPPLE_UCI_H
+#define TOPPLE_UCI_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "board.h"
+#include "hash.h"
+#include "eval.h"
+#include "search.h"
+#include "output.h"
+#include "cluster.h"
+#include "book.h"
+
+namespace uci {
+    /**
+     * Search threads and hash memory shared by all sessions of a server. Requests are granted from whatever is left of
+     * the budget. A search waits until at least one thread is free, while a hash table always gets at least one
+     * megabyte.
+     */
+    class budget_t {
+    public:
+        budget_t(size_t threads, size_t hash_mb);
+
+        /**
+         * Wait until a thread is free, and take up to the requested number of threads.
+         *
+         * @param cancel stops the wait when set
+         * @return the number of threads taken, or 0 if the wait was cancelled
+         */
+        size_t acquire_threads(size_t requested, const std::atomic_bool &cancel);
+        void release_threads(size_t count);
+
+        size_t acquire_hash(size_t requested_mb);
+        void release_hash(size_t mb);
+    private:
+        std::mutex mtx;
+        std::condition_variable threads_freed;
+
+        size_t threads_total, threads_used = 0;
+        size_t hash_total, hash_used = 0;
+    };
+
+    /**
+     * A UCI engine: the state of one game, driven by UCI commands. Standalone sessions own all of their resources,
+     * while sessions hosted by a server take their search threads and hash table from the server's budget, and share
+     * the tablebases configured for the server.
+     */
+    class session_t {
+    public:
+        session_t(output::writer_t &out, const processed_params_t &params, budget_t *budget = nullptr);
+        ~session_t();
+        session_t(const session_t &) = delete;
+
+        /**
+         * Handle one line of UCI input.
+         *
+         * @return false if the session should end
+         */
+        bool handle(const std::string &input);
+    private:
+        void resize_hash();
+        void create_search(size_t search_threads);
+        move_t unsearched_move();
+        void use_peer_result(const cluster::peer_result_t &peer, search_result_t &result);
+
+        output::writer_t &out;
+        const processed_params_t &params;
+        budget_t *budget;
+
+        // Board
+        std::unique_ptr<board_t> board = nullptr;
+
+        // Last position and moves played on the board, used to play only the new moves of an extended move list
+        std::string position_fen;
+        std::vector<std::string> position_moves;
+
+        // Hash
+        size_t hash_size = 128;
+        size_t hash_granted = 0;
+        std::unique_ptr<tt::hash_t> tt;
+        std::mutex tt_memory_mtx;
+
+        // Search
+        std::unique_ptr<search_t> search;
+        size_t search_threads = 0;
+        std::atomic_bool search_abort = false;
+        std::future<void> future;
+        std::atomic_bool search_active = false;
+        std::unique_ptr<cluster::front_t> cluster;
+        std::shared_ptr<const book::book_t> book;
+        int book_depth = 20;
+        std::shared_ptr<const nnue::network_t> network;
+
+        // Parameters
+        size_t threads = 1;
+        bool deterministic = false;
+        int move_overhead = 50;
+        size_t syzygy_resolve = 512;
+        std::string tb_path;
+    };
+}
+
+#endif //TOPPLE_UCI_H